@@ -42,6 +42,7 @@ public:
     void copy(Buffer& dstBuffer);
     void copyToTexture(Texture& dstTexture, int layer, vk::Offset3D offset, vk::Extent3D extent);
     void copyToTexture(Texture& dstTexture, int layer);
+    void copyToTexture(Texture& dstTexture, const std::vector<vk::BufferImageCopy>& regions);
 
     void* mapMemory(vk::DeviceSize offset, vk::DeviceSize size);
     void* mapMemory();
@@ -0,0 +1,43 @@
+#pragma once
+
+#include "../Include/Base.h"
+#include "../Include/MappedFile.h"
+#include <memory>
+
+// Everything needed to create the image and record its copies. Regions are laid out exactly as
+// vk::BufferImageCopy expects, with tightly packed rows and bufferOffset relative to the start of
+// the texel data.
+struct CookedTextureLayout {
+    vk::ImageViewType viewType;
+    vk::Format format;
+    vk::Extent3D extent;
+    uint32_t layerCount;
+    uint32_t mipLevels;
+    std::vector<vk::BufferImageCopy> regions;
+};
+
+// A cooked texture file mapped into memory. data points into the mapping, which stays alive as
+// long as any copy of the struct does.
+struct CookedTexture {
+    CookedTextureLayout layout;
+    std::shared_ptr<MappedFile> file;
+    const uint8_t* data;
+    size_t size;
+};
+
+// Number of levels in a full mip chain down to 1x1.
+uint32_t mipLevelCount(vk::Extent3D extent);
+
+// Packs the RGBA8 base level followed by levelCount - 1 box filtered levels into one buffer, and
+// appends a copy region for each level to regions, for layer zero and offsets from the start of
+// the returned buffer.
+std::vector<uint8_t> createMipChain(
+    const uint8_t* pixels,
+    vk::Extent3D extent,
+    uint32_t levelCount,
+    std::vector<vk::BufferImageCopy>& regions);
+
+void writeCookedTexture(
+    const std::string& filename, const CookedTextureLayout& layout, const std::vector<uint8_t>& data);
+
+CookedTexture readCookedTexture(const std::string& filename);
@@ -0,0 +1,39 @@
+#pragma once
+
+#include "../Include/Base.h"
+
+struct DdsLevel {
+    size_t offset;
+    size_t size;
+    vk::Extent3D extent;
+};
+
+// Contents of a DDS container. Levels are stored layer major, the level for a given layer and
+// mip is levels[layer * mipLevels + mip], and the offsets point into data.
+struct DdsImage {
+    vk::Format format;
+    vk::Extent3D extent;
+    uint32_t mipLevels;
+    uint32_t layerCount;
+    bool cube;
+    std::vector<char> data;
+    std::vector<DdsLevel> levels;
+};
+
+DdsImage readDdsFile(const std::string& filename);
+
+// Reads only the headers, so levels and data are left empty.
+DdsImage readDdsHeader(const std::string& filename);
+
+bool isBlockCompressed(vk::Format format);
+
+// Bytes in one tightly packed 2D level, in whole blocks for compressed formats and RGBA8 texels
+// otherwise.
+size_t levelSize(vk::Format format, vk::Extent3D extent);
+
+// Uncompressed format the CPU decoder produces for a block compressed format. Throws for formats
+// the CPU cannot decode, such as BC7.
+vk::Format decompressedFormat(vk::Format format);
+
+// Decodes one BC1-BC5 level into tightly packed RGBA8 texels.
+std::vector<char> decompressBlocks(vk::Format format, const char* blocks, vk::Extent3D extent);
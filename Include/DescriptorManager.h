@@ -4,6 +4,7 @@
 #include "../Include/Base.h"
 #include "../Include/DescriptorSet.h"
 #include <list>
+#include <memory>
 
 const int maxSets = 10;
 
@@ -48,6 +49,20 @@ private:
     std::list<vk::DescriptorPool> mPools;
 };
 
+struct PipelineLayoutContainer {
+    std::vector<vk::DescriptorSetLayout> setLayouts;
+    std::vector<vk::PushConstantRange> pushConstantRanges;
+    vk::PipelineLayout layout;
+};
+
+struct SharedDescriptorSet {
+    vk::DescriptorSetLayout layout;
+    uint32_t binding;
+    vk::ImageView imageView;
+    vk::Sampler sampler;
+    std::weak_ptr<DescriptorSet> descriptorSet;
+};
+
 class DescriptorManager {
 public:
     DescriptorManager(const DescriptorManager&) = delete;
@@ -56,13 +71,35 @@ public:
 
     DescriptorManager(Device& device);
 
+    ~DescriptorManager();
+
     DescriptorManager& operator=(const DescriptorManager&) = delete;
 
     DescriptorManager& operator=(DescriptorManager&&) = delete;
 
     DescriptorSet createDescriptorSet(std::vector<vk::DescriptorSetLayoutBinding> bindings);
 
+    // Returns the set for the bindings with only the image written to the binding. Callers asking
+    // for the same bindings and image share one set for as long as any of them holds it, so it
+    // must not be written to afterwards.
+    std::shared_ptr<DescriptorSet> sharedImageDescriptorSet(
+        std::vector<vk::DescriptorSetLayoutBinding> bindings,
+        uint32_t binding,
+        const vk::DescriptorImageInfo& imageInfo);
+
+    // Layouts are shared between all callers asking for identical bindings, so sets created
+    // from the same bindings are always compatible with pipelines built from them.
+    vk::DescriptorSetLayout descriptorSetLayout(std::vector<vk::DescriptorSetLayoutBinding> bindings);
+
+    vk::PipelineLayout pipelineLayout(
+        const std::vector<vk::DescriptorSetLayout>& setLayouts,
+        const std::vector<vk::PushConstantRange>& pushConstantRanges);
+
 private:
+    DescriptorContainer& descriptorContainer(std::vector<vk::DescriptorSetLayoutBinding> bindings);
+
     Device& mDevice;
     std::list<DescriptorContainer> mContainers;
+    std::vector<PipelineLayoutContainer> mPipelineLayouts;
+    std::vector<SharedDescriptorSet> mSharedDescriptorSets;
 };
@@ -37,6 +37,11 @@ public:
         return mLayout;
     }
 
+    const std::vector<vk::DescriptorSetLayoutBinding>& bindings() const
+    {
+        return mBindings;
+    }
+
     void writeDescriptors(std::vector<DescriptorWrite> descriptorWrites);
 
 private:
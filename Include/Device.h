@@ -1,6 +1,10 @@
 #pragma once
 
 #include "../Include/Base.h"
+#include "../Include/PipelineLibrary.h"
+#include "../Include/SamplerCache.h"
+#include "../Include/ShaderLibrary.h"
+#include "../Include/ThreadPool.h"
 
 struct QueueFamilyIndices {
     int graphics = -1;
@@ -68,6 +72,37 @@ public:
         return mCommandPool;
     }
 
+    vk::PipelineCache pipelineCache() const
+    {
+        return mPipelineCache;
+    }
+
+    ThreadPool& threadPool()
+    {
+        return mThreadPool;
+    }
+
+    ShaderLibrary& shaderLibrary()
+    {
+        return mShaderLibrary;
+    }
+
+    SamplerCache& samplerCache()
+    {
+        return mSamplerCache;
+    }
+
+    PipelineLibrary& pipelineLibrary()
+    {
+        return mPipelineLibrary;
+    }
+
+    // Whether one vkCmdDrawIndexedIndirect may issue more than one draw.
+    bool multiDrawIndirect() const
+    {
+        return mMultiDrawIndirect;
+    }
+
     uint32_t findMemoryType(uint32_t typeFilter, vk::MemoryPropertyFlags properties) const;
 
     vk::CommandBuffer createAndBeginCommandBuffer();
@@ -87,6 +122,12 @@ private:
     vk::Queue mGraphicsQueue;
     vk::Queue mPresentQueue;
     vk::CommandPool mCommandPool;
+    vk::PipelineCache mPipelineCache;
+    ShaderLibrary mShaderLibrary;
+    SamplerCache mSamplerCache;
+    PipelineLibrary mPipelineLibrary;
+    ThreadPool mThreadPool;
+    bool mMultiDrawIndirect;
 };
 
 vk::Format findDepthAttachmentFormat(Device& device);
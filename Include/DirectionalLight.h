@@ -59,4 +59,6 @@ public:
     Texture mDepthTexture;
     //Material mMaterial;
     Pipeline mPipeline;
+    // Same shader reading CompressedMeshVertex, whose positions the pushed matrix decodes.
+    Pipeline mCompressedPipeline;
 };
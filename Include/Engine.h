@@ -5,6 +5,7 @@
 #include "../Include/DescriptorManager.h"
 #include "../Include/Device.h"
 #include "../Include/DirectionalLight.h"
+#include "../Include/Material.h"
 #include "../Include/Mesh.h"
 #include "../Include/Quad.h"
 #include "../Include/Renderer.h"
@@ -34,6 +35,11 @@ public:
 
     Mesh createModelFromFile(std::string filename);
 
+    // Decodes all mesh files, with their LODs and meshlets, and their material files in parallel
+    // on the device thread pool, then creates the meshes in order. Materials, textures and
+    // shaders shared between meshes are loaded once by their caches.
+    std::vector<Mesh> createModelsFromFiles(const std::vector<std::string>& filenames);
+
     GLFWwindow* window()
     {
         return mWindow;
@@ -56,6 +62,11 @@ public:
         return mTextureManager;
     }
 
+    MaterialCache& materialCache()
+    {
+        return mMaterialCache;
+    }
+
     //
     //    SwapChain& swapChain()
     //    {
@@ -89,6 +100,7 @@ private:
     Texture mDepthTexture;
     DescriptorManager mDescriptorManager;
     TextureManager mTextureManager;
+    MaterialCache mMaterialCache;
     Renderer mRenderer;
 
 public:
@@ -1,6 +1,7 @@
 #pragma once
 
 #include "../Include/Base.h"
+#include "../Include/PipelineDescription.h"
 
 class Device;
 class SwapChain;
@@ -16,7 +17,7 @@ public:
         Device& device,
         SwapChain& swapChain,
         Texture* depthTexture,
-        const nlohmann::json& json);
+        PipelineUsage usage);
 
     ~FramebufferSet();
 
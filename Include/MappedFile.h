@@ -0,0 +1,36 @@
+#pragma once
+
+#include "../Include/Base.h"
+
+// Read-only view of a whole file mapped into the address space. Pages are faulted in by the OS on
+// first touch, so reading a file this way costs no extra copy into a heap buffer.
+class MappedFile {
+public:
+    MappedFile(const MappedFile&) = delete;
+
+    MappedFile(MappedFile&&) = delete;
+
+    MappedFile(const std::string& filename);
+
+    ~MappedFile();
+
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    MappedFile& operator=(MappedFile&&) = delete;
+
+    const char* data() const
+    {
+        return mData;
+    }
+
+    size_t size() const
+    {
+        return mSize;
+    }
+
+private:
+    HANDLE mFile;
+    size_t mSize;
+    HANDLE mMapping;
+    const char* mData;
+};
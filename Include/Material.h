@@ -1,55 +1,80 @@
-/*
 #pragma once
 
 #include "../Include/Base.h"
-#include "../Include/Buffer.h"
-#include "../Include/DescriptorManager.h"
-#include "../Include/SwapChain.h"
-#include "../Include/Texture.h"
+#include "../Include/Pipeline.h"
+#include "../Include/PipelineDescription.h"
+#include <limits>
+#include <mutex>
+#include <unordered_map>
 
-class TextureManager;
+// Decoded material file, shared by every mesh that names it. The pipeline owns the pipeline
+// layout, the material descriptor set and the material texture.
+struct Material {
+    std::string filename;
+    PipelineDescription description;
+    std::unique_ptr<Pipeline> pipeline;
+};
 
-class Material {
-public:
-    Material(const Material&) = delete;
+struct MaterialHandle {
+    uint32_t index = std::numeric_limits<uint32_t>::max();
 
-    Material(Material&& rhs);
+    bool valid() const
+    {
+        return index != std::numeric_limits<uint32_t>::max();
+    }
 
-    Material(
-        Device& device,
-        DescriptorManager& descriptorManager,
-        SwapChain& swapChain,
-        Texture* depthTexture,
-        Texture* texture);
+    bool operator<(const MaterialHandle& rhs) const
+    {
+        return index < rhs.index;
+    }
+
+    bool operator==(const MaterialHandle& rhs) const
+    {
+        return index == rhs.index;
+    }
+};
+
+class MaterialCache {
+public:
+    MaterialCache(const MaterialCache&) = delete;
 
-    Material(
+    MaterialCache(MaterialCache&&) = delete;
+
+    MaterialCache(
         Device& device,
         DescriptorManager& descriptorManager,
         TextureManager& textureManager,
         SwapChain& swapChain,
-        Texture* depthTexture,
-        const nlohmann::json& json);
+        Texture& depthTexture);
 
-    ~Material();
+    ~MaterialCache();
 
-    Material& operator=(const Material&) = delete;
+    MaterialCache& operator=(const MaterialCache&) = delete;
 
-    Material& operator=(Material&&) = delete;
+    MaterialCache& operator=(MaterialCache&&) = delete;
 
-    Texture* texture()
-    {
-        return mTexture;
-    }
+    // Loads the compiled, or as a fallback JSON, material file on first use; later calls with the
+    // same path return the same handle. Safe to call from the device thread pool.
+    MaterialHandle load(const std::string& filename);
 
-    DescriptorSet& descriptorSet()
-    {
-        return mDescriptorSet;
-    }
+    const Material& material(MaterialHandle handle) const;
+
+    // Creates the pipelines of the materials loaded since the last call. Must run on the thread
+    // that records and submits device work, after any textures the materials sample are packed.
+    void createPipelines();
+
+    // Throws unless createPipelines has run since the material was loaded.
+    Pipeline& pipeline(MaterialHandle handle);
+
+    size_t size() const;
 
 private:
     Device& mDevice;
-    Texture* mTexture;
-    DescriptorSet mDescriptorSet;
+    DescriptorManager& mDescriptorManager;
+    TextureManager& mTextureManager;
+    SwapChain& mSwapChain;
+    Texture& mDepthTexture;
+    mutable std::mutex mMutex;
+    std::vector<std::unique_ptr<Material>> mMaterials;
+    std::unordered_map<std::string, uint32_t> mMaterialsByFilename;
 };
-
-*/
@@ -3,18 +3,23 @@
 #include "../Include/Base.h"
 #include "../Include/Buffer.h"
 #include "../Include/DescriptorManager.h"
-#include "../Include/Object.h"
-#include "../Include/Pipeline.h"
+#include "../Include/Material.h"
+#include "../Include/MeshFile.h"
+#include "../Include/Meshlet.h"
 #include "../Include/Texture.h"
 
 class Device;
 
+// For meshes with compressed vertices world also decodes the positions, and normals are
+// transformed by normalWorld instead. The padding keeps normalWorld at its std140 offset.
 struct MeshUniform {
     glm::mat4 world;
     glm::mat4 view;
     glm::mat4 proj;
     glm::mat4 lightSpace;
     glm::vec3 lightDir;
+    float padding;
+    glm::mat4 normalWorld;
 };
 
 struct MeshVertex {
@@ -33,12 +38,12 @@ struct MeshVertex {
 
         attributeDescriptions[0].binding = 0;
         attributeDescriptions[0].location = 0;
-        attributeDescriptions[0].format = vk::Format::eR32G32B32A32Sfloat;
+        attributeDescriptions[0].format = vk::Format::eR32G32B32Sfloat;
         attributeDescriptions[0].offset = offsetof(MeshVertex, position);
 
         attributeDescriptions[1].binding = 0;
         attributeDescriptions[1].location = 1;
-        attributeDescriptions[1].format = vk::Format::eR32G32B32A32Sfloat;
+        attributeDescriptions[1].format = vk::Format::eR32G32B32Sfloat;
         attributeDescriptions[1].offset = offsetof(MeshVertex, normal);
 
         attributeDescriptions[2].binding = 0;
@@ -54,7 +59,69 @@ struct MeshVertex {
     glm::vec2 texCoord;
 };
 
-class Mesh : public Object {
+// Half the size of MeshVertex. Positions are 16 bit unorm relative to the mesh bounds, normals
+// are octahedral encoded snorm16 and texture coordinates are half floats. Vertex shaders decode
+// them with Shaders/CompressedVertex.glsl.
+struct CompressedMeshVertex {
+    static vk::VertexInputBindingDescription bindingDescription()
+    {
+        vk::VertexInputBindingDescription bindingDescription = {};
+        bindingDescription.binding = 0;
+        bindingDescription.stride = sizeof(CompressedMeshVertex);
+        bindingDescription.inputRate = vk::VertexInputRate::eVertex;
+        return bindingDescription;
+    }
+
+    static std::vector<vk::VertexInputAttributeDescription> attributeDescriptions()
+    {
+        std::vector<vk::VertexInputAttributeDescription> attributeDescriptions(3);
+
+        attributeDescriptions[0].binding = 0;
+        attributeDescriptions[0].location = 0;
+        attributeDescriptions[0].format = vk::Format::eR16G16B16A16Unorm;
+        attributeDescriptions[0].offset = offsetof(CompressedMeshVertex, position);
+
+        attributeDescriptions[1].binding = 0;
+        attributeDescriptions[1].location = 1;
+        attributeDescriptions[1].format = vk::Format::eR16G16Snorm;
+        attributeDescriptions[1].offset = offsetof(CompressedMeshVertex, normal);
+
+        attributeDescriptions[2].binding = 0;
+        attributeDescriptions[2].location = 2;
+        attributeDescriptions[2].format = vk::Format::eR16G16Sfloat;
+        attributeDescriptions[2].offset = offsetof(CompressedMeshVertex, texCoord);
+
+        return attributeDescriptions;
+    }
+
+    uint16_t position[4];
+    int16_t normal[2];
+    uint16_t texCoord[2];
+};
+
+std::vector<CompressedMeshVertex> compressVertices(
+    const std::vector<MeshVertex>& vertices, const MeshBounds& bounds);
+
+// Maps decoded unorm positions back into model space. Folding it into the world matrix used for
+// positions avoids any decode work in the shader; normals must keep the plain world matrix.
+glm::mat4 positionDecodeMatrix(const MeshBounds& bounds);
+
+// Bindings of the per mesh descriptor set 0: the MeshUniform and the shadow map. Material
+// pipelines are laid out against the same bindings.
+std::vector<vk::DescriptorSetLayoutBinding> meshDescriptorBindings();
+
+// Device local vertex and index buffers of one mesh, filled by uploadMeshGeometry.
+struct MeshGeometry {
+    Buffer vertexBuffer;
+    Buffer indexBuffer;
+    bool compressedVertices;
+    vk::IndexType indexType;
+    size_t indexCount;
+};
+
+// Geometry, uniform and object descriptor set of one mesh. Everything drawn with the mesh's
+// material, from the pipeline to the material texture, is owned by the MaterialCache.
+class Mesh {
 public:
     Mesh(const Mesh&) = delete;
 
@@ -63,28 +130,181 @@ public:
     Mesh(
         Device& device,
         DescriptorManager& descriptorManager,
-        TextureManager& textureManager,
-        SwapChain& swapChain,
-        Texture& depthTexture,
         glm::mat4 worldMatrix,
-        std::vector<Vertex> vertices,
-        std::vector<uint32_t> indices,
-        const nlohmann::json& json,
+        MeshGeometry geometry,
         Texture* shadowMap,
-        std::vector<glm::mat4> keyframes);
+        std::vector<glm::mat4> keyframes,
+        std::vector<MeshLod> lods,
+        MeshBounds bounds,
+        std::vector<Meshlet> meshlets,
+        MaterialHandle material);
 
     Mesh& operator=(const Mesh&) = delete;
 
     Mesh& operator=(Mesh&&) = delete;
 
+    Buffer& vertexBuffer()
+    {
+        return mVertexBuffer;
+    }
+
+    Buffer& indexBuffer()
+    {
+        return mIndexBuffer;
+    }
+
+    vk::DescriptorSet descriptorSet()
+    {
+        return mDescriptorSet;
+    }
+
+    const glm::mat4& worldMatrix() const
+    {
+        return mWorldMatrix;
+    }
+
+    void setWorldMatrix(const glm::mat4& worldMatrix)
+    {
+        mWorldMatrix = worldMatrix;
+    }
+
+    // Transforms the positions in the vertex buffer to world space, decoding compressed ones.
+    glm::mat4 positionWorldMatrix() const
+    {
+        return mWorldMatrix * mPositionDecode;
+    }
+
+    // The vertex buffer holds CompressedMeshVertex instead of MeshVertex.
+    bool compressedVertices() const
+    {
+        return mCompressedVertices;
+    }
+
+    const std::vector<glm::mat4>& keyframes() const
+    {
+        return mKeyframes;
+    }
+
+    void updateUniformBuffer(
+        const glm::mat4& viewMatrix,
+        const glm::mat4& projMatrix,
+        const glm::mat4& lightSpaceMatrix,
+        const glm::vec3& lightDir);
+
+    // eUint16 whenever every index fits, which halves the index buffer.
+    vk::IndexType indexType() const
+    {
+        return mIndexType;
+    }
+
+    // Meshes naming the same material file share the handle, so draws can be sorted by it.
+    MaterialHandle material() const
+    {
+        return mMaterial;
+    }
+
+    size_t indexCount() const
+    {
+        return mIndexCount;
+    }
+
+    // Chooses the LODs drawn this frame from the projected size of the bounding sphere, once for
+    // the camera and once for the shadow map, whose orthographic projection ignores distance.
+    void selectLods(
+        const glm::vec3& cameraPosition,
+        const glm::mat4& projMatrix,
+        const glm::mat4& lightProjMatrix,
+        vk::Extent2D extent);
+
+    const MeshLod& lod() const
+    {
+        return mLods[mLod];
+    }
+
+    const MeshLod& shadowLod() const
+    {
+        return mLods[mShadowLod];
+    }
+
+    // Fills the indirect draws of both passes with the meshlets of the selected LODs that survive
+    // frustum culling, plus back-face cone culling in the main pass when the material culls back
+    // faces. Must not be called while a command buffer drawing the mesh is pending.
+    void cullMeshlets(
+        const glm::vec3& cameraPosition,
+        const glm::mat4& viewProjMatrix,
+        const glm::mat4& lightViewProjMatrix,
+        vk::CullModeFlags cullMode);
+
+    void draw(vk::CommandBuffer commandBuffer) const;
+
+    void drawShadow(vk::CommandBuffer commandBuffer) const;
+
 private:
+    void drawIndirect(
+        vk::CommandBuffer commandBuffer, uint32_t firstDraw, uint32_t drawCount) const;
+
+    Device& mDevice;
+    bool mCompressedVertices;
+    glm::mat4 mWorldMatrix;
+    glm::mat4 mPositionDecode;
+    Buffer mVertexBuffer;
+    Buffer mIndexBuffer;
+    Buffer mUniformBuffer;
+    MeshUniform mUniform;
+    DescriptorSet mDescriptorSet;
+    std::vector<glm::mat4> mKeyframes;
+    vk::IndexType mIndexType;
+    size_t mIndexCount;
+    std::vector<MeshLod> mLods;
+    MeshBounds mBounds;
+    size_t mLod;
+    size_t mShadowLod;
+    std::vector<Meshlet> mMeshlets;
+    MeshletBounds mMeshletBounds;
+    std::vector<size_t> mLodMeshlets;
+    uint32_t mMaxDrawCount;
+    Buffer mDrawBuffer;
+    vk::DrawIndexedIndirectCommand* mDraws;
+    uint32_t mDrawCount;
+    uint32_t mShadowDrawCount;
+    bool mMultiDrawIndirect;
+    MaterialHandle mMaterial;
 };
 
+// Everything a mesh file decodes to before any device work. Produced by loadMeshAsset, which
+// touches no shared state and may run on worker threads.
+struct MeshAsset {
+    glm::mat4 worldMatrix;
+    std::vector<MeshVertex> vertices;
+    std::vector<uint32_t> indices;
+    std::vector<MeshLod> lods;
+    MeshBounds bounds;
+    std::vector<Meshlet> meshlets;
+    std::vector<glm::mat4> keyframes;
+    std::string material;
+};
+
+MeshAsset loadMeshAsset(const std::string& filename);
+
+// Copies the vertices and indices of every asset into device local buffers through one staging
+// buffer and a single submission. Vertices are compressed for materials that opt in.
+std::vector<MeshGeometry> uploadMeshGeometry(
+    Device& device, MaterialCache& materialCache, const std::vector<MeshAsset>& assets);
+
+// Creates the uniform and descriptor set of a decoded mesh around its uploaded geometry, and the
+// pipeline of its material if this is the first mesh using it. Must run on the thread that
+// records and submits device work.
+Mesh createMesh(
+    Device& device,
+    DescriptorManager& descriptorManager,
+    Texture* shadowMap,
+    MaterialCache& materialCache,
+    MeshAsset asset,
+    MeshGeometry geometry);
+
 Mesh createMeshFromFile(
     Device& device,
     DescriptorManager& descriptorManager,
-    TextureManager& textureManager,
-    SwapChain& swapChain,
-    Texture& depthTexture,
     Texture* shadowMap,
+    MaterialCache& materialCache,
     std::string filename);
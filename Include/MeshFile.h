@@ -0,0 +1,42 @@
+#pragma once
+
+#include "../Include/Base.h"
+
+// Vertex record as stored in mesh files, eight tightly packed floats.
+struct MeshFileVertex {
+    float position[3];
+    float normal[3];
+    float texCoord[2];
+};
+
+// One level of detail, a range of the index array.
+struct MeshLod {
+    uint32_t firstIndex;
+    uint32_t indexCount;
+    float error;
+};
+
+struct MeshBounds {
+    glm::vec3 min;
+    glm::vec3 max;
+};
+
+// Contents of a mesh file in either format. LOD zero always covers the full index array.
+struct MeshData {
+    glm::mat4 worldMatrix;
+    std::vector<MeshFileVertex> vertices;
+    std::vector<uint32_t> indices;
+    MeshBounds bounds;
+    std::vector<MeshLod> lods;
+    std::vector<glm::mat4> keyframes;
+    std::string material;
+};
+
+MeshBounds meshBounds(const std::vector<MeshFileVertex>& vertices);
+
+// Reads a chunked mesh file, or a legacy "paskaformaatti 1.0" file.
+MeshData readMeshFile(const std::string& filename);
+
+// Writes the chunked format. Every payload starts on a 16 byte boundary and carries a checksum
+// in the chunk table, so vertex and index chunks can be copied or mapped straight into buffers.
+void writeMeshFile(const std::string& filename, const MeshData& mesh);
@@ -0,0 +1,32 @@
+#pragma once
+
+#include "../Include/MeshFile.h"
+
+// Post-transform vertex cache behaviour of an index buffer, simulated with a FIFO cache. ACMR is
+// cache misses per triangle, ATVR is cache misses per referenced vertex; 1.0 is the ideal ATVR.
+struct VertexCacheStatistics {
+    uint32_t misses;
+    float acmr;
+    float atvr;
+};
+
+VertexCacheStatistics analyzeVertexCache(
+    const uint32_t* indices, size_t indexCount, size_t vertexCount, uint32_t cacheSize = 16);
+
+// Merges bitwise identical vertices and remaps the indices.
+void deduplicateVertices(MeshData& mesh);
+
+// Reorders triangles for vertex cache locality with Forsyth's linear speed algorithm.
+void optimizeVertexCache(uint32_t* indices, size_t indexCount, size_t vertexCount);
+
+// Splits cache optimized triangles into clusters at the points where the cache starts over and
+// orders the clusters outside in, so front surfaces tend to be drawn first. Vertex cache
+// efficiency is unchanged since no cluster is broken up.
+void optimizeOverdraw(
+    uint32_t* indices, size_t indexCount, const std::vector<MeshFileVertex>& vertices);
+
+// Orders vertices by first use in the index buffer and drops unreferenced vertices.
+void optimizeVertexFetch(MeshData& mesh);
+
+// Runs every stage above, cache and overdraw per LOD range.
+void optimizeMesh(MeshData& mesh);
@@ -0,0 +1,19 @@
+#pragma once
+
+#include "../Include/MeshFile.h"
+
+// Quadric error edge collapse that only ever moves a vertex onto one of its neighbours, so the
+// simplified index list still addresses the original vertex array. Stops at targetIndexCount or
+// when no collapse is left that keeps borders, attribute seams and triangle orientation intact.
+// error receives the largest collapse error as a model space distance.
+std::vector<uint32_t> simplifyMesh(
+    const uint32_t* indices,
+    size_t indexCount,
+    const std::vector<MeshFileVertex>& vertices,
+    size_t targetIndexCount,
+    float& error);
+
+// Replaces the LODs of the mesh by LOD zero followed by up to lodCount - 1 simplified levels,
+// each with about half the triangles of the previous one. The levels are appended to the index
+// array and share the vertex array.
+void generateLods(MeshData& mesh, uint32_t lodCount = 4);
@@ -0,0 +1,63 @@
+#pragma once
+
+#include "../Include/MeshFile.h"
+#include <array>
+
+const uint32_t meshletMaxVertices = 64;
+const uint32_t meshletMaxTriangles = 124;
+
+// A contiguous run of triangles in the index buffer, bounded so it can be culled as a whole.
+// Every triangle faces away from a viewer at v when dot(normalize(coneApex - v), coneAxis) is at
+// least coneCutoff; a cutoff above one disables back-face culling for the meshlet.
+struct Meshlet {
+    uint32_t firstIndex;
+    uint32_t indexCount;
+    glm::vec3 center;
+    float radius;
+    glm::vec3 coneApex;
+    glm::vec3 coneAxis;
+    float coneCutoff;
+};
+
+// Splits indices into meshlets of at most meshletMaxVertices unique vertices and
+// meshletMaxTriangles triangles. Triangles keep their order, so running the vertex cache
+// optimizer first gives compact meshlets. firstIndex is the offset of indices in the index buffer.
+std::vector<Meshlet> buildMeshlets(
+    const uint32_t* indices,
+    size_t indexCount,
+    uint32_t firstIndex,
+    const std::vector<MeshFileVertex>& vertices);
+
+// Meshlet bounds as structure of arrays, padded so the culling loop can always load four lanes.
+struct MeshletBounds {
+    std::vector<float> centerX;
+    std::vector<float> centerY;
+    std::vector<float> centerZ;
+    std::vector<float> radius;
+    std::vector<float> apexX;
+    std::vector<float> apexY;
+    std::vector<float> apexZ;
+    std::vector<float> axisX;
+    std::vector<float> axisY;
+    std::vector<float> axisZ;
+    std::vector<float> cutoff;
+};
+
+MeshletBounds meshletBounds(const std::vector<Meshlet>& meshlets);
+
+// Normalized left, right, bottom, top, near and far planes of a Vulkan clip space matrix. Passing
+// proj * view * world gives the planes in model space.
+std::array<glm::vec4, 6> frustumPlanes(const glm::mat4& matrix);
+
+// Writes an indexed draw for each of meshlets[first, first + count) that intersects the frustum
+// and, with cone culling, is not facing away from viewPosition. Planes and viewPosition are in
+// model space. Tests four meshlets at a time with SSE and returns the number of draws written.
+uint32_t cullMeshlets(
+    const std::vector<Meshlet>& meshlets,
+    const MeshletBounds& bounds,
+    size_t first,
+    size_t count,
+    const std::array<glm::vec4, 6>& planes,
+    const glm::vec3& viewPosition,
+    bool coneCulling,
+    vk::DrawIndexedIndirectCommand* commands);
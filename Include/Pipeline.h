@@ -3,11 +3,32 @@
 
 #include "../Include/DescriptorSet.h"
 #include "../Include/FramebufferSet.h"
+#include "../Include/PipelineDescription.h"
+#include "../Include/PipelineLibrary.h"
+#include "../Include/TextureManager.h"
+#include <future>
+#include <map>
+#include <memory>
 
 class DescriptorManager;
-class TextureManager;
 class Texture;
 
+struct PipelineReflection {
+    std::map<uint32_t, std::vector<vk::DescriptorSetLayoutBinding>> descriptorSets;
+    std::vector<vk::PushConstantRange> pushConstantRanges;
+    bool materialConstants;
+    bool hasVertexShader;
+    std::vector<uint32_t> vertexInputLocations;
+};
+
+// Pushed only to shaders whose push constant block starts with these members, as confirmed by
+// reflection. Maps texture coordinates into the packed texture array; identity when the material
+// texture is not packed. Shaders wrap repeating coordinates with fract before the transform.
+struct MaterialConstants {
+    glm::vec4 uvTransform;
+    uint32_t layer;
+};
+
 class Pipeline {
 public:
     Pipeline(const Pipeline&) = delete;
@@ -23,7 +44,7 @@ public:
         vk::VertexInputBindingDescription bindingDescription,
         std::vector<vk::VertexInputAttributeDescription> attributeDescriptions,
         vk::DescriptorSetLayout descriptorSetLayout,
-        const nlohmann::json& json);
+        const PipelineDescription& description);
 
     ~Pipeline();
 
@@ -31,9 +52,21 @@ public:
 
     Pipeline& operator=(Pipeline&&) = delete;
 
+    // Blocks until the pipeline has been compiled on the device thread pool. Pipelines built from
+    // the same key share one compiled pipeline.
     operator vk::Pipeline() const
     {
-        return mPipeline;
+        return mPipeline.get();
+    }
+
+    bool ready() const
+    {
+        return mPipeline.wait_for(std::chrono::seconds(0)) == std::future_status::ready;
+    }
+
+    void wait() const
+    {
+        mPipeline.wait();
     }
 
     FramebufferSet& framebufferSet()
@@ -46,16 +79,62 @@ public:
         return mPipelineLayout;
     }
 
+    // Shared with every pipeline whose material texture was packed into the same array.
     DescriptorSet& descriptorSet()
     {
-        return mDescriptorSet;
+        return *mDescriptorSet;
+    }
+
+    const PipelineReflection& reflection() const
+    {
+        return mReflection;
     }
 
+    const MaterialConstants& materialConstants() const
+    {
+        return mMaterialConstants;
+    }
+
+    vk::CullModeFlags cullMode() const
+    {
+        return mCullMode;
+    }
+
+    // Pushes the bytes of [offset, offset + size) that fall inside the reflected push constant
+    // ranges, naming every stage that declares them. Bytes no shader declares are skipped.
+    void pushConstants(
+        vk::CommandBuffer commandBuffer, uint32_t offset, uint32_t size, const void* data) const;
+
+    // True when the shaders read MaterialConstants, so the material texture may be packed.
+    static bool samplesPackedTextures(Device& device, const PipelineDescription& description);
+
+    // Does nothing unless a shader declares a push constant block laid out as MaterialConstants.
+    void pushMaterialConstants(vk::CommandBuffer commandBuffer) const;
+
+    // The material texture streams in after construction and starts out as a placeholder.
+    void setTexturePriority(float priority);
+
+    // Keeps the material texture resident while the pipeline is being drawn.
+    void markTextureUsed();
+
+    // Points the descriptor set at the latest streamed stage of the material texture. Must not be
+    // called while a command buffer using the descriptor set is pending.
+    void updateTexture();
+
 private:
     Device& mDevice;
+    TextureManager& mTextureManager;
     FramebufferSet mFramebufferSet;
-    Texture* mTexture;
-    DescriptorSet mDescriptorSet;
+    PipelineReflection mReflection;
+    TextureHandle mTexture;
+    uint32_t mTextureRevision;
+    MaterialConstants mMaterialConstants;
+    vk::CullModeFlags mCullMode;
+    std::shared_ptr<DescriptorSet> mDescriptorSet;
     vk::PipelineLayout mPipelineLayout;
-    vk::Pipeline mPipeline;
+    PipelineKey mPipelineKey;
+    std::shared_future<vk::Pipeline> mPipeline;
 };
+
+// Sets the dynamic viewport and scissor state shared by every pipeline to cover the extent.
+void setViewportAndScissor(vk::CommandBuffer commandBuffer, vk::Extent2D extent);
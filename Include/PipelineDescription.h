@@ -0,0 +1,38 @@
+#pragma once
+
+#include "../Include/Base.h"
+
+enum class PipelineUsage : uint32_t { Default, Clear, Skybox, Quad, ShadowMap };
+
+struct SpecializationConstantDescription {
+    std::string key;
+    double value;
+};
+
+// Runtime form of a pipeline/material description. JSON is only the authoring format; the
+// offline pipeline compiler writes this struct to a compact binary file that the loader maps
+// back without any string comparisons.
+struct PipelineDescription {
+    PipelineUsage usage = PipelineUsage::Default;
+    std::string vertexShader;
+    std::string fragmentShader;
+    std::string texture;
+    vk::PolygonMode polygonMode = vk::PolygonMode::eFill;
+    vk::CullModeFlags cullMode = vk::CullModeFlagBits::eNone;
+    bool depthTestEnable = false;
+    bool depthWriteEnable = false;
+    vk::CompareOp depthCompareOp = vk::CompareOp::eNever;
+    std::vector<SpecializationConstantDescription> specializationConstants;
+    // Meshes drawn with the material upload CompressedMeshVertex instead of MeshVertex, so the
+    // vertex shader must decode them.
+    bool compressedVertices = false;
+};
+
+PipelineDescription parsePipelineDescription(const nlohmann::json& json);
+
+PipelineDescription readPipelineDescription(const std::vector<char>& data);
+
+void writePipelineDescription(const std::string& filename, const PipelineDescription& description);
+
+// Loads a compiled description, or parses a JSON file when the file is not compiled.
+PipelineDescription loadPipelineDescription(const std::string& filename);
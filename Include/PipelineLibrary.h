@@ -0,0 +1,68 @@
+#pragma once
+
+#include "../Include/Base.h"
+#include "../Include/PipelineDescription.h"
+#include <functional>
+#include <future>
+#include <mutex>
+#include <unordered_map>
+
+// Everything that ends up in vk::GraphicsPipelineCreateInfo. Render passes are created per
+// FramebufferSet but are compatible whenever the color format and usage match, so those stand in
+// for the render pass handle. The description's texture is not compared since it is bound through
+// a descriptor set.
+struct PipelineKey {
+    PipelineDescription description;
+    vk::Format colorFormat;
+    vk::VertexInputBindingDescription bindingDescription;
+    std::vector<vk::VertexInputAttributeDescription> attributeDescriptions;
+    vk::PipelineLayout layout;
+
+    bool operator==(const PipelineKey& rhs) const;
+};
+
+struct PipelineKeyHash {
+    size_t operator()(const PipelineKey& key) const;
+};
+
+class PipelineLibrary {
+public:
+    PipelineLibrary(const PipelineLibrary&) = delete;
+
+    PipelineLibrary(PipelineLibrary&&) = delete;
+
+    PipelineLibrary(vk::Device device);
+
+    ~PipelineLibrary();
+
+    PipelineLibrary& operator=(const PipelineLibrary&) = delete;
+
+    PipelineLibrary& operator=(PipelineLibrary&&) = delete;
+
+    // Returns the shared pipeline for the key, calling compile to start building it on first
+    // use. Every call holds a reference until release is called with the same key.
+    std::shared_future<vk::Pipeline> acquire(
+        const PipelineKey& key, const std::function<std::shared_future<vk::Pipeline>()>& compile);
+
+    // Destroys the pipeline when the last reference is dropped.
+    void release(const PipelineKey& key);
+
+    size_t pipelineCount() const
+    {
+        return mPipelines.size();
+    }
+
+    void clear();
+
+private:
+    struct Entry {
+        std::shared_future<vk::Pipeline> pipeline;
+        uint32_t refCount;
+    };
+
+    void destroyPipeline(const std::shared_future<vk::Pipeline>& pipeline);
+
+    vk::Device mDevice;
+    std::mutex mMutex;
+    std::unordered_map<PipelineKey, Entry, PipelineKeyHash> mPipelines;
+};
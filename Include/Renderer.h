@@ -9,6 +9,7 @@ struct UboWorldView {
 
 class Device;
 class FramebufferSet;
+class MaterialCache;
 class Mesh;
 class Quad;
 class Skybox;
@@ -30,7 +31,13 @@ public:
 
     Renderer& operator=(Renderer&&) = delete;
 
-    void drawFrame(std::vector<Mesh>& models, Skybox& skybox, Quad& quad, DirectionalLight& light);
+    // Draws the models with the pipelines of their materials.
+    void drawFrame(
+        std::vector<Mesh>& models,
+        MaterialCache& materialCache,
+        Skybox& skybox,
+        Quad& quad,
+        DirectionalLight& light);
 
 private:
     Device& mDevice;
@@ -0,0 +1,63 @@
+#pragma once
+
+#include "../Include/Base.h"
+#include <unordered_map>
+
+// Full sampler state used as the cache key. Every field that ends up in vk::SamplerCreateInfo is
+// part of the key so two textures only share a sampler when they would sample identically.
+struct SamplerState {
+    vk::Filter magFilter = vk::Filter::eLinear;
+    vk::Filter minFilter = vk::Filter::eLinear;
+    vk::SamplerMipmapMode mipmapMode = vk::SamplerMipmapMode::eLinear;
+    vk::SamplerAddressMode addressModeU = vk::SamplerAddressMode::eRepeat;
+    vk::SamplerAddressMode addressModeV = vk::SamplerAddressMode::eRepeat;
+    vk::SamplerAddressMode addressModeW = vk::SamplerAddressMode::eRepeat;
+    float mipLodBias = 0.0f;
+    bool anisotropyEnable = true;
+    float maxAnisotropy = 16.0f;
+    bool compareEnable = false;
+    vk::CompareOp compareOp = vk::CompareOp::eAlways;
+    float minLod = 0.0f;
+    float maxLod = VK_LOD_CLAMP_NONE;
+    vk::BorderColor borderColor = vk::BorderColor::eFloatOpaqueWhite;
+    bool unnormalizedCoordinates = false;
+
+    bool operator==(const SamplerState& rhs) const;
+};
+
+struct SamplerStateHash {
+    size_t operator()(const SamplerState& state) const;
+};
+
+// Linear filtered, anisotropic sampler with the same address mode on every axis.
+SamplerState samplerState(vk::SamplerAddressMode addressMode);
+
+class SamplerCache {
+public:
+    SamplerCache(const SamplerCache&) = delete;
+
+    SamplerCache(SamplerCache&&) = delete;
+
+    SamplerCache(vk::Device device);
+
+    ~SamplerCache();
+
+    SamplerCache& operator=(const SamplerCache&) = delete;
+
+    SamplerCache& operator=(SamplerCache&&) = delete;
+
+    // Returns the shared sampler for the state, creating it on first use. The cache owns the
+    // sampler, callers must not destroy it.
+    vk::Sampler sampler(const SamplerState& state);
+
+    size_t samplerCount() const
+    {
+        return mSamplers.size();
+    }
+
+    void clear();
+
+private:
+    vk::Device mDevice;
+    std::unordered_map<SamplerState, vk::Sampler, SamplerStateHash> mSamplers;
+};
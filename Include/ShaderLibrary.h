@@ -0,0 +1,80 @@
+#pragma once
+
+#include "../Include/Base.h"
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+
+struct UniformMemberReflection {
+    std::string name;
+    uint32_t offset;
+    size_t size;
+    uint32_t arrayStride;
+};
+
+struct UniformBufferReflection {
+    std::string name;
+    uint32_t set;
+    uint32_t binding;
+    size_t size;
+    std::vector<UniformMemberReflection> members;
+};
+
+struct DescriptorBindingReflection {
+    std::string name;
+    uint32_t set;
+    vk::DescriptorSetLayoutBinding binding;
+};
+
+enum class SpecializationConstantType { Bool, Int, UInt, Float };
+
+struct SpecializationConstantReflection {
+    std::string name;
+    uint32_t constantId;
+    SpecializationConstantType type;
+};
+
+struct ShaderReflection {
+    vk::ShaderStageFlagBits stage;
+    std::vector<DescriptorBindingReflection> descriptorBindings;
+    std::vector<vk::PushConstantRange> pushConstantRanges;
+    std::vector<UniformMemberReflection> pushConstantMembers;
+    std::vector<uint32_t> inputLocations;
+    std::vector<SpecializationConstantReflection> specializationConstants;
+    std::vector<UniformBufferReflection> uniformBuffers;
+};
+
+struct Shader {
+    std::string filename;
+    uint64_t hash;
+    std::vector<uint32_t> code;
+    vk::ShaderModule module;
+    ShaderReflection reflection;
+};
+
+class ShaderLibrary {
+public:
+    ShaderLibrary(const ShaderLibrary&) = delete;
+
+    ShaderLibrary(ShaderLibrary&&) = delete;
+
+    ShaderLibrary(vk::Device device);
+
+    ~ShaderLibrary();
+
+    ShaderLibrary& operator=(const ShaderLibrary&) = delete;
+
+    ShaderLibrary& operator=(ShaderLibrary&&) = delete;
+
+    // Loads, validates and reflects the SPIR-V file on first use. Files with identical contents
+    // share a single shader module. Safe to call from the device thread pool.
+    const Shader& shader(const std::string& filename);
+
+    void clear();
+
+private:
+    vk::Device mDevice;
+    std::mutex mMutex;
+    std::unordered_map<std::string, Shader*> mShadersByFilename;
+    std::unordered_map<uint64_t, std::vector<std::unique_ptr<Shader>>> mShadersByHash;
+};
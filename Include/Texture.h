@@ -19,7 +19,8 @@ public:
         vk::ImageTiling tiling,
         vk::ImageUsageFlags usage,
         vk::MemoryPropertyFlags memoryProperties,
-        vk::SamplerAddressMode addressMode);
+        vk::SamplerAddressMode addressMode,
+        uint32_t mipLevels = 1);
 
     ~Texture();
 
@@ -47,6 +48,11 @@ public:
         return mExtent;
     }
 
+    uint32_t mipLevels() const
+    {
+        return mMipLevels;
+    }
+
     vk::Format format() const
     {
         return mFormat;
@@ -57,6 +63,8 @@ public:
         return mMemory;
     }
 
+    vk::DeviceSize memorySize() const;
+
     vk::Image image() const
     {
         return mImage;
@@ -67,6 +75,7 @@ public:
         return mImageView;
     }
 
+    // Shared through the device sampler cache, not owned by the texture.
     vk::Sampler sampler() const
     {
         return mSampler;
@@ -75,11 +84,16 @@ public:
     void transitionLayout(
         vk::ImageLayout oldLayout, vk::ImageLayout newLayout, vk::CommandBuffer externalCommandBuffer = nullptr);
 
+    // Fills mip levels 1..n from level 0 with successive blits. Expects every level in
+    // eTransferDstOptimal and leaves the whole chain in eShaderReadOnlyOptimal.
+    void generateMipmaps(vk::CommandBuffer externalCommandBuffer = nullptr);
+
 private:
     Device& mDevice;
     vk::ImageViewType mType;
     uint32_t mLayerCount;
     vk::Extent3D mExtent;
+    uint32_t mMipLevels;
     vk::Format mFormat;
     vk::Image mImage;
     vk::DeviceMemory mMemory;
@@ -87,5 +101,8 @@ private:
     vk::Sampler mSampler;
 };
 
+// True when the format can be downsampled with a linear filtered blitImage.
+bool supportsLinearBlit(Device& device, vk::Format format);
+
 //Texture createTextureFromFile(Device& device, std::string filename, vk::SamplerAddressMode addressMode);
 //Texture createCubeTextureFromFile(Device& device, std::string filename);
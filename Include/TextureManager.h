@@ -1,15 +1,78 @@
 #pragma once
 
 #include "../Include/Base.h"
+#include "../Include/CookedTexture.h"
 #include "../Include/Texture.h"
+#include <future>
+#include <map>
+#include <memory>
+#include <unordered_map>
 
 class Device;
 
-struct TextureContainer {
-    TextureContainer(std::string filename, Texture texture);
+// Generational handle into the texture registry. A handle whose slot has been reused by another
+// texture no longer resolves, so stale handles are caught instead of aliasing the new texture.
+struct TextureHandle {
+    uint32_t index = 0;
+    uint32_t generation = 0;
 
+    bool valid() const
+    {
+        return generation != 0;
+    }
+};
+
+struct TextureSlot {
     std::string filename;
-    Texture texture;
+    std::unique_ptr<Texture> texture;
+    uint32_t generation;
+    uint32_t refCount;
+    uint32_t revision;
+    vk::SamplerAddressMode addressMode;
+    bool evictable;
+    bool evicted;
+    uint64_t lastUsedFrame;
+    vk::DeviceSize memorySize;
+};
+
+// Location of a small texture packed into a shared 2D texture array. Texture coordinates map into
+// the array as (uv * uvTransform.xy + uvTransform.zw, layer). Textures smaller than their layer
+// sit in its corner, padded by repeating their last column and row.
+struct PackedTexture {
+    TextureHandle texture;
+    glm::vec4 uvTransform;
+    uint32_t layer;
+};
+
+// CPU side result of decoding a texture file, ready to be copied into a staging buffer. Cooked
+// textures keep their texels in the mapped file and leave data empty.
+struct TextureData {
+    vk::ImageViewType viewType;
+    vk::Format format;
+    vk::Extent3D extent;
+    uint32_t layerCount;
+    uint32_t mipLevels;
+    bool generateMipmaps;
+    vk::SamplerAddressMode addressMode;
+    std::vector<uint8_t> data;
+    std::vector<vk::BufferImageCopy> regions;
+    CookedTexture cooked;
+};
+
+// A texture being streamed in. Stages are ordered from lowest to full resolution and each one
+// replaces the previous in the slot as it is uploaded.
+struct StreamRequest {
+    uint32_t index;
+    uint32_t generation;
+    float priority;
+    std::future<std::vector<TextureData>> decoded;
+    std::vector<TextureData> stages;
+    size_t nextStage;
+};
+
+struct PendingTexture {
+    std::unique_ptr<Texture> texture;
+    uint64_t frame;
 };
 
 class TextureManager {
@@ -20,15 +83,119 @@ public:
 
     TextureManager(Device& device);
 
+    ~TextureManager();
+
     TextureManager& operator=(const TextureManager&) = delete;
 
     TextureManager& operator=(TextureManager&&) = delete;
 
+    // Returns a handle holding one reference to the texture, loading the file on first use.
+    TextureHandle loadTexture(const std::string& filename, vk::SamplerAddressMode addressMode);
+
+    // Decodes all files in parallel on the device thread pool and uploads them in one submission.
+    // Returns one handle per filename, in order.
+    std::vector<TextureHandle> loadTextures(
+        const std::vector<std::string>& filenames, vk::SamplerAddressMode addressMode);
+
+    TextureHandle loadCubeTexture(const std::array<std::string, 6>& filenames);
+
+    // Decodes one file per array layer, or per depth slice of a 3D texture, and uploads every
+    // layer and mip through one staging buffer with a single copy in one submission. All files
+    // must have the same size and format.
+    TextureHandle loadLayeredTexture(
+        const std::vector<std::string>& filenames,
+        vk::ImageViewType viewType,
+        vk::SamplerAddressMode addressMode);
+
+    // Packs small textures with the same format into the layers of shared 2D texture arrays, one
+    // array per power of two layer size, so materials using them sample one image. Every
+    // returned entry holds a reference to its array. Packed textures stay registered while their
+    // array is referenced, and pipelines created meanwhile naming the same file pick them up.
+    std::vector<PackedTexture> packTextures(
+        const std::vector<std::string>& filenames, vk::SamplerAddressMode addressMode);
+
+    // Reads only the file header. True for single layer 2D textures small enough to pack.
+    bool isPackable(const std::string& filename) const;
+
+    // Returns null when the file has not been packed.
+    const PackedTexture* packedTexture(const std::string& filename) const;
+
+    // Returns immediately with a 2D texture handle that resolves to a placeholder until the file
+    // has been decoded and uploaded by updateStreaming. Higher priority textures upload first.
+    TextureHandle streamTexture(
+        const std::string& filename, vk::SamplerAddressMode addressMode, float priority);
+
+    void setStreamingPriority(TextureHandle handle, float priority);
+
+    // Uploads decoded stream stages in priority order within a per-frame byte budget. Called
+    // once per frame before descriptors are refreshed.
+    void updateStreaming();
+
+    Texture& texture(TextureHandle handle);
+
+    // Changes every time a streamed stage replaces the texture behind the handle, or the texture
+    // is evicted.
+    uint32_t revision(TextureHandle handle);
+
+    // Records that the renderer sampled the texture this frame. An evicted texture is streamed
+    // back in from its file.
+    void markUsed(TextureHandle handle);
+
+    // Streamed textures not used in the last frame are evicted in least recently used order while
+    // resident texture memory exceeds the budget. Unlimited by default.
+    void setMemoryBudget(vk::DeviceSize budget)
+    {
+        mMemoryBudget = budget;
+    }
+
+    vk::DeviceSize residentMemory() const;
+
+    void acquire(TextureHandle handle);
+
+    // Drops one reference. Unreferenced textures are destroyed by collectGarbage once the frames
+    // that may still sample them have completed.
+    void release(TextureHandle handle);
+
+    // Called once per frame after submission.
+    void collectGarbage();
+
+    // Loads a texture that stays resident for the lifetime of the manager.
     Texture& createTextureFromFile(std::string filename, vk::SamplerAddressMode addressMode);
 
     Texture& createCubeTextureFromFile(std::array<std::string, 6> filenames);
 
 private:
+    TextureSlot& slot(TextureHandle handle);
+
+    TextureHandle allocateSlot(const std::string& filename, vk::SamplerAddressMode addressMode);
+
+    TextureHandle insertTexture(
+        const std::string& filename, vk::SamplerAddressMode addressMode, Texture texture);
+
+    void requestStream(TextureHandle handle, float priority);
+
+    void installStage(StreamRequest& request, Texture texture);
+
+    bool isStreaming(uint32_t index) const;
+
+    void enforceMemoryBudget();
+
+    void finishStreaming(uint32_t index);
+
+    void makeResident(TextureHandle handle);
+
+    std::vector<Texture> uploadTextures(std::vector<TextureData>& textures);
+
     Device& mDevice;
-    std::vector<TextureContainer> mTextures;
+    std::vector<TextureSlot> mSlots;
+    std::vector<uint32_t> mFreeSlots;
+    // The sampler is part of the texture, so the same file with another address mode gets a slot
+    // of its own.
+    std::map<std::pair<std::string, vk::SamplerAddressMode>, uint32_t> mSlotsBySource;
+    std::vector<PendingTexture> mPendingTextures;
+    uint64_t mFrame;
+    Texture mPlaceholder;
+    std::vector<StreamRequest> mStreamRequests;
+    vk::DeviceSize mMemoryBudget;
+    std::unordered_map<std::string, PackedTexture> mPackedTextures;
 };
@@ -0,0 +1,59 @@
+#pragma once
+
+#include "../Include/Base.h"
+#include <condition_variable>
+#include <functional>
+#include <future>
+#include <mutex>
+#include <queue>
+#include <thread>
+
+class ThreadPool {
+public:
+    ThreadPool(const ThreadPool&) = delete;
+
+    ThreadPool(ThreadPool&&) = delete;
+
+    ThreadPool(size_t threadCount);
+
+    ~ThreadPool();
+
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    ThreadPool& operator=(ThreadPool&&) = delete;
+
+    size_t threadCount() const
+    {
+        return mThreads.size();
+    }
+
+    template <typename Function>
+    auto submit(Function&& function) -> std::future<decltype(function())>
+    {
+        using Result = decltype(function());
+        auto task = std::make_shared<std::packaged_task<Result()>>(std::forward<Function>(function));
+        std::future<Result> future = task->get_future();
+        {
+            std::lock_guard<std::mutex> lock{mMutex};
+            if (mStopping) {
+                throw std::runtime_error("Thread pool is shut down!");
+            }
+            mTasks.emplace([task]() { (*task)(); });
+        }
+        mCondition.notify_one();
+        return future;
+    }
+
+    void shutdown();
+
+private:
+    void run();
+
+    std::vector<std::thread> mThreads;
+    std::queue<std::function<void()>> mTasks;
+    std::mutex mMutex;
+    std::condition_variable mCondition;
+    bool mStopping;
+};
+
+size_t defaultThreadCount();
@@ -0,0 +1,24 @@
+// Decoding for CompressedMeshVertex. Bind the attributes as
+//
+//     layout(location = 0) in vec4 inPosition;   // R16G16B16A16_UNORM
+//     layout(location = 1) in vec2 inNormal;     // R16G16_SNORM
+//     layout(location = 2) in vec2 inTexCoord;   // R16G16_SFLOAT
+//
+// Texture coordinates need no decoding. Positions are either transformed by a world matrix that
+// already contains positionDecodeMatrix, as MeshUniform.world does for materials with
+// "compressedVertices", or decoded here from the mesh bounds. Decoded normals are transformed by
+// MeshUniform.normalWorld.
+
+vec3 decodePosition(vec4 position, vec3 boundsMin, vec3 boundsExtent)
+{
+    return boundsMin + position.xyz * boundsExtent;
+}
+
+vec3 decodeNormal(vec2 encoded)
+{
+    vec3 normal = vec3(encoded, 1.0 - abs(encoded.x) - abs(encoded.y));
+    float fold = max(-normal.z, 0.0);
+    normal.x += normal.x >= 0.0 ? -fold : fold;
+    normal.y += normal.y >= 0.0 ? -fold : fold;
+    return normalize(normal);
+}
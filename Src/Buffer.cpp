@@ -80,6 +80,16 @@ void Buffer::copyToTexture(Texture& dstTexture, int layer)
     copyToTexture(dstTexture, layer, vk::Offset3D(0, 0, 0), dstTexture.extent());
 }
 
+void Buffer::copyToTexture(Texture& dstTexture, const std::vector<vk::BufferImageCopy>& regions)
+{
+    vk::CommandBuffer commandBuffer = mDevice.createAndBeginCommandBuffer();
+
+    commandBuffer.copyBufferToImage(
+        mBuffer, dstTexture.image(), vk::ImageLayout::eTransferDstOptimal, regions);
+
+    mDevice.flushAndFreeCommandBuffer(commandBuffer);
+}
+
 void* Buffer::mapMemory(vk::DeviceSize offset, vk::DeviceSize size)
 {
     void* data{};
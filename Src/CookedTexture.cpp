@@ -0,0 +1,256 @@
+#include "../Include/CookedTexture.h"
+#include "../Include/DdsFile.h"
+#include <algorithm>
+#include <fstream>
+
+const uint32_t cookedTextureMagic = 0x58455443; // "CTEX"
+const uint32_t cookedTextureVersion = 1;
+
+// Texel data starts at a multiple of this, matching the alignment used for staging uploads.
+const size_t cookedTextureAlignment = 16;
+
+uint32_t mipLevelCount(vk::Extent3D extent)
+{
+    uint32_t size = std::max(extent.width, extent.height);
+    uint32_t levels = 1;
+    while (size > 1) {
+        size /= 2;
+        levels++;
+    }
+    return levels;
+}
+
+std::vector<uint8_t> createMipChain(
+    const uint8_t* pixels,
+    vk::Extent3D extent,
+    uint32_t levelCount,
+    std::vector<vk::BufferImageCopy>& regions)
+{
+    const uint32_t bytesPerPixel = 4;
+    uint32_t width = extent.width;
+    uint32_t height = extent.height;
+
+    std::vector<uint8_t> chain(pixels, pixels + width * height * bytesPerPixel);
+    size_t srcOffset = 0;
+
+    for (uint32_t level = 0; level < levelCount; level++) {
+        if (level > 0) {
+            uint32_t levelWidth = std::max(width / 2, 1u);
+            uint32_t levelHeight = std::max(height / 2, 1u);
+            size_t dstOffset = chain.size();
+            chain.resize(dstOffset + levelWidth * levelHeight * bytesPerPixel);
+
+            for (uint32_t y = 0; y < levelHeight; y++) {
+                uint32_t y0 = std::min(y * 2, height - 1);
+                uint32_t y1 = std::min(y * 2 + 1, height - 1);
+                for (uint32_t x = 0; x < levelWidth; x++) {
+                    uint32_t x0 = std::min(x * 2, width - 1);
+                    uint32_t x1 = std::min(x * 2 + 1, width - 1);
+                    for (uint32_t c = 0; c < bytesPerPixel; c++) {
+                        uint32_t sum = chain[srcOffset + (y0 * width + x0) * bytesPerPixel + c] +
+                            chain[srcOffset + (y0 * width + x1) * bytesPerPixel + c] +
+                            chain[srcOffset + (y1 * width + x0) * bytesPerPixel + c] +
+                            chain[srcOffset + (y1 * width + x1) * bytesPerPixel + c];
+                        chain[dstOffset + (y * levelWidth + x) * bytesPerPixel + c] =
+                            static_cast<uint8_t>((sum + 2) / 4);
+                    }
+                }
+            }
+
+            srcOffset = dstOffset;
+            width = levelWidth;
+            height = levelHeight;
+        }
+
+        vk::BufferImageCopy region{};
+        region.bufferOffset = srcOffset;
+        region.imageSubresource.aspectMask = vk::ImageAspectFlagBits::eColor;
+        region.imageSubresource.mipLevel = level;
+        region.imageSubresource.baseArrayLayer = 0;
+        region.imageSubresource.layerCount = 1;
+        region.imageExtent = vk::Extent3D{width, height, 1};
+        regions.push_back(region);
+    }
+
+    return chain;
+}
+
+template <typename T>
+static void write(std::ofstream& file, T value)
+{
+    file.write(reinterpret_cast<const char*>(&value), sizeof(T));
+}
+
+void writeCookedTexture(
+    const std::string& filename, const CookedTextureLayout& layout, const std::vector<uint8_t>& data)
+{
+    std::ofstream file(filename, std::ios::out | std::ios::binary);
+    if (!file.is_open()) {
+        throw std::runtime_error("Failed to open cooked texture for writing!");
+    }
+
+    write(file, cookedTextureMagic);
+    write(file, cookedTextureVersion);
+    write(file, static_cast<uint32_t>(layout.viewType));
+    write(file, static_cast<uint32_t>(layout.format));
+    write(file, layout.extent.width);
+    write(file, layout.extent.height);
+    write(file, layout.extent.depth);
+    write(file, layout.layerCount);
+    write(file, layout.mipLevels);
+    write(file, static_cast<uint32_t>(layout.regions.size()));
+    write(file, static_cast<uint64_t>(data.size()));
+
+    for (auto& region : layout.regions) {
+        write(file, static_cast<uint64_t>(region.bufferOffset));
+        write(file, region.imageSubresource.mipLevel);
+        write(file, region.imageSubresource.baseArrayLayer);
+        write(file, region.imageExtent.width);
+        write(file, region.imageExtent.height);
+        write(file, region.imageExtent.depth);
+    }
+
+    size_t offset = static_cast<size_t>(file.tellp());
+    size_t padding = (cookedTextureAlignment - offset % cookedTextureAlignment) %
+        cookedTextureAlignment;
+    const char zeros[cookedTextureAlignment] = {};
+    file.write(zeros, padding);
+    file.write(reinterpret_cast<const char*>(data.data()), data.size());
+}
+
+// The formats the cooker writes, RGBA8 images and the block compressed DDS formats.
+static bool isCookedFormat(vk::Format format)
+{
+    switch (format) {
+    case vk::Format::eR8G8B8A8Unorm:
+    case vk::Format::eR8G8B8A8Srgb:
+    case vk::Format::eBc1RgbaUnormBlock:
+    case vk::Format::eBc1RgbaSrgbBlock:
+    case vk::Format::eBc2UnormBlock:
+    case vk::Format::eBc2SrgbBlock:
+    case vk::Format::eBc3UnormBlock:
+    case vk::Format::eBc3SrgbBlock:
+    case vk::Format::eBc4UnormBlock:
+    case vk::Format::eBc4SnormBlock:
+    case vk::Format::eBc5UnormBlock:
+    case vk::Format::eBc5SnormBlock:
+    case vk::Format::eBc7UnormBlock:
+    case vk::Format::eBc7SrgbBlock:
+        return true;
+    default:
+        return false;
+    }
+}
+
+static bool isCookedViewType(vk::ImageViewType viewType)
+{
+    return viewType == vk::ImageViewType::e2D || viewType == vk::ImageViewType::e2DArray ||
+        viewType == vk::ImageViewType::eCube || viewType == vk::ImageViewType::eCubeArray;
+}
+
+// Everything later copies and decodes straight from the mapping, so the layout is checked against
+// the image and the data before anything uses it.
+static void validateCookedLayout(
+    const CookedTextureLayout& layout, uint64_t dataSize, const std::string& filename)
+{
+    if (!isCookedViewType(layout.viewType) || !isCookedFormat(layout.format)) {
+        throw std::runtime_error("Unsupported cooked texture type or format: " + filename);
+    }
+    if (layout.extent.width == 0 || layout.extent.height == 0 || layout.extent.depth != 1 ||
+        layout.layerCount == 0 || layout.mipLevels == 0 ||
+        layout.mipLevels > mipLevelCount(layout.extent)) {
+        throw std::runtime_error("Invalid cooked texture layout: " + filename);
+    }
+    bool cube = layout.viewType == vk::ImageViewType::eCube ||
+        layout.viewType == vk::ImageViewType::eCubeArray;
+    if (cube && layout.layerCount % 6 != 0) {
+        throw std::runtime_error("Cooked cube texture needs six layers per cube: " + filename);
+    }
+
+    for (auto& region : layout.regions) {
+        uint32_t level = region.imageSubresource.mipLevel;
+        uint32_t layer = region.imageSubresource.baseArrayLayer;
+        if (level >= layout.mipLevels || layer >= layout.layerCount) {
+            throw std::runtime_error("Cooked texture region outside the image: " + filename);
+        }
+
+        vk::Extent3D levelExtent{
+            std::max(1u, layout.extent.width >> level),
+            std::max(1u, layout.extent.height >> level),
+            1};
+        if (region.imageExtent != levelExtent) {
+            throw std::runtime_error("Cooked texture region has the wrong size: " + filename);
+        }
+
+        uint64_t size = levelSize(layout.format, levelExtent);
+        if (region.bufferOffset > dataSize || size > dataSize - region.bufferOffset) {
+            throw std::runtime_error("Cooked texture region outside the data: " + filename);
+        }
+    }
+}
+
+struct CookedTextureReader {
+    const MappedFile& file;
+    size_t offset;
+
+    template <typename T>
+    T read()
+    {
+        if (offset + sizeof(T) > file.size()) {
+            throw std::runtime_error("Truncated cooked texture!");
+        }
+        T value{};
+        memcpy(&value, file.data() + offset, sizeof(T));
+        offset += sizeof(T);
+        return value;
+    }
+};
+
+CookedTexture readCookedTexture(const std::string& filename)
+{
+    CookedTexture texture{};
+    texture.file = std::make_shared<MappedFile>(filename);
+    CookedTextureReader reader{*texture.file, 0};
+
+    if (reader.read<uint32_t>() != cookedTextureMagic) {
+        throw std::runtime_error("Not a cooked texture: " + filename);
+    }
+    if (reader.read<uint32_t>() != cookedTextureVersion) {
+        throw std::runtime_error("Unsupported cooked texture version: " + filename);
+    }
+
+    CookedTextureLayout& layout = texture.layout;
+    layout.viewType = static_cast<vk::ImageViewType>(reader.read<uint32_t>());
+    layout.format = static_cast<vk::Format>(reader.read<uint32_t>());
+    layout.extent.width = reader.read<uint32_t>();
+    layout.extent.height = reader.read<uint32_t>();
+    layout.extent.depth = reader.read<uint32_t>();
+    layout.layerCount = reader.read<uint32_t>();
+    layout.mipLevels = reader.read<uint32_t>();
+    uint32_t regionCount = reader.read<uint32_t>();
+    uint64_t dataSize = reader.read<uint64_t>();
+
+    for (uint32_t i = 0; i < regionCount; i++) {
+        vk::BufferImageCopy region{};
+        region.bufferOffset = reader.read<uint64_t>();
+        region.imageSubresource.aspectMask = vk::ImageAspectFlagBits::eColor;
+        region.imageSubresource.mipLevel = reader.read<uint32_t>();
+        region.imageSubresource.baseArrayLayer = reader.read<uint32_t>();
+        region.imageSubresource.layerCount = 1;
+        region.imageExtent.width = reader.read<uint32_t>();
+        region.imageExtent.height = reader.read<uint32_t>();
+        region.imageExtent.depth = reader.read<uint32_t>();
+        layout.regions.push_back(region);
+    }
+
+    size_t dataOffset = (reader.offset + cookedTextureAlignment - 1) / cookedTextureAlignment *
+        cookedTextureAlignment;
+    if (dataOffset > texture.file->size() || dataSize > texture.file->size() - dataOffset) {
+        throw std::runtime_error("Truncated cooked texture: " + filename);
+    }
+    validateCookedLayout(layout, dataSize, filename);
+
+    texture.data = reinterpret_cast<const uint8_t*>(texture.file->data()) + dataOffset;
+    texture.size = static_cast<size_t>(dataSize);
+    return texture;
+}
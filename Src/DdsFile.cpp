@@ -0,0 +1,390 @@
+#include "../Include/DdsFile.h"
+#include <algorithm>
+#include <fstream>
+
+const uint32_t ddsMagic = 0x20534444; // "DDS "
+const uint32_t ddsHeaderSize = 124;
+const uint32_t ddsHeaderDx10Size = 20;
+const uint32_t ddsFourCCFlag = 0x4;
+const uint32_t ddsCubemapFlag = 0x200;
+const uint32_t ddsDx10CubeFlag = 0x4;
+
+static uint32_t fourCC(const char* code)
+{
+    return static_cast<uint32_t>(code[0]) | (static_cast<uint32_t>(code[1]) << 8) |
+        (static_cast<uint32_t>(code[2]) << 16) | (static_cast<uint32_t>(code[3]) << 24);
+}
+
+static uint32_t readUInt32(const std::vector<char>& data, size_t offset)
+{
+    if (offset + sizeof(uint32_t) > data.size()) {
+        throw std::runtime_error("Truncated DDS file!");
+    }
+    uint32_t value = 0;
+    memcpy(&value, data.data() + offset, sizeof(value));
+    return value;
+}
+
+static vk::Format formatFromFourCC(uint32_t code)
+{
+    if (code == fourCC("DXT1")) {
+        return vk::Format::eBc1RgbaUnormBlock;
+    } else if (code == fourCC("DXT3")) {
+        return vk::Format::eBc2UnormBlock;
+    } else if (code == fourCC("DXT5")) {
+        return vk::Format::eBc3UnormBlock;
+    } else if (code == fourCC("ATI1") || code == fourCC("BC4U")) {
+        return vk::Format::eBc4UnormBlock;
+    } else if (code == fourCC("ATI2") || code == fourCC("BC5U")) {
+        return vk::Format::eBc5UnormBlock;
+    } else {
+        throw std::runtime_error("Unsupported DDS pixel format!");
+    }
+}
+
+static vk::Format formatFromDxgi(uint32_t dxgiFormat)
+{
+    switch (dxgiFormat) {
+    case 28:
+        return vk::Format::eR8G8B8A8Unorm;
+    case 29:
+        return vk::Format::eR8G8B8A8Srgb;
+    case 71:
+        return vk::Format::eBc1RgbaUnormBlock;
+    case 72:
+        return vk::Format::eBc1RgbaSrgbBlock;
+    case 74:
+        return vk::Format::eBc2UnormBlock;
+    case 75:
+        return vk::Format::eBc2SrgbBlock;
+    case 77:
+        return vk::Format::eBc3UnormBlock;
+    case 78:
+        return vk::Format::eBc3SrgbBlock;
+    case 80:
+        return vk::Format::eBc4UnormBlock;
+    case 81:
+        return vk::Format::eBc4SnormBlock;
+    case 83:
+        return vk::Format::eBc5UnormBlock;
+    case 84:
+        return vk::Format::eBc5SnormBlock;
+    case 98:
+        return vk::Format::eBc7UnormBlock;
+    case 99:
+        return vk::Format::eBc7SrgbBlock;
+    default:
+        throw std::runtime_error("Unsupported DDS DXGI format!");
+    }
+}
+
+static size_t blockSize(vk::Format format)
+{
+    switch (format) {
+    case vk::Format::eBc1RgbaUnormBlock:
+    case vk::Format::eBc1RgbaSrgbBlock:
+    case vk::Format::eBc4UnormBlock:
+    case vk::Format::eBc4SnormBlock:
+        return 8;
+    default:
+        return 16;
+    }
+}
+
+size_t levelSize(vk::Format format, vk::Extent3D extent)
+{
+    if (isBlockCompressed(format)) {
+        size_t blocksWide = std::max(1u, (extent.width + 3) / 4);
+        size_t blocksHigh = std::max(1u, (extent.height + 3) / 4);
+        return blocksWide * blocksHigh * blockSize(format);
+    } else {
+        return static_cast<size_t>(extent.width) * extent.height * 4;
+    }
+}
+
+// Fills in everything but the levels from the headers at the start of image.data and returns the
+// offset of the first level.
+static size_t parseDdsHeader(DdsImage& image, const std::string& filename)
+{
+    if (readUInt32(image.data, 0) != ddsMagic || readUInt32(image.data, 4) != ddsHeaderSize) {
+        throw std::runtime_error("Invalid DDS file: " + filename);
+    }
+
+    const size_t header = 4;
+    image.extent.height = readUInt32(image.data, header + 8);
+    image.extent.width = readUInt32(image.data, header + 12);
+    image.extent.depth = 1;
+    image.mipLevels = std::max(1u, readUInt32(image.data, header + 24));
+
+    uint32_t pixelFormatFlags = readUInt32(image.data, header + 76);
+    uint32_t pixelFormatFourCC = readUInt32(image.data, header + 80);
+    uint32_t caps2 = readUInt32(image.data, header + 108);
+
+    if (!(pixelFormatFlags & ddsFourCCFlag)) {
+        throw std::runtime_error("Unsupported DDS pixel format: " + filename);
+    }
+
+    size_t offset = header + ddsHeaderSize;
+    if (pixelFormatFourCC == fourCC("DX10")) {
+        image.format = formatFromDxgi(readUInt32(image.data, offset));
+        uint32_t miscFlag = readUInt32(image.data, offset + 8);
+        image.layerCount = std::max(1u, readUInt32(image.data, offset + 12));
+        image.cube = (miscFlag & ddsDx10CubeFlag) != 0;
+        if (image.cube) {
+            image.layerCount *= 6;
+        }
+        offset += ddsHeaderDx10Size;
+    } else {
+        image.format = formatFromFourCC(pixelFormatFourCC);
+        image.cube = (caps2 & ddsCubemapFlag) != 0;
+        image.layerCount = image.cube ? 6 : 1;
+    }
+
+    return offset;
+}
+
+DdsImage readDdsFile(const std::string& filename)
+{
+    DdsImage image{};
+    image.data = readFile(filename);
+    size_t offset = parseDdsHeader(image, filename);
+
+    for (uint32_t layer = 0; layer < image.layerCount; layer++) {
+        vk::Extent3D extent = image.extent;
+        for (uint32_t level = 0; level < image.mipLevels; level++) {
+            size_t size = levelSize(image.format, extent);
+            if (offset + size > image.data.size()) {
+                throw std::runtime_error("Truncated DDS file: " + filename);
+            }
+
+            image.levels.push_back({offset, size, extent});
+            offset += size;
+            extent.width = std::max(1u, extent.width / 2);
+            extent.height = std::max(1u, extent.height / 2);
+        }
+    }
+
+    return image;
+}
+
+DdsImage readDdsHeader(const std::string& filename)
+{
+    std::ifstream file{filename, std::ios::binary};
+    if (!file.is_open()) {
+        throw std::runtime_error("Failed to open file " + filename);
+    }
+
+    DdsImage image{};
+    image.data.resize(4 + ddsHeaderSize + ddsHeaderDx10Size);
+    file.read(image.data.data(), image.data.size());
+    image.data.resize(static_cast<size_t>(file.gcount()));
+
+    parseDdsHeader(image, filename);
+    image.data.clear();
+    return image;
+}
+
+bool isBlockCompressed(vk::Format format)
+{
+    return format >= vk::Format::eBc1RgbUnormBlock && format <= vk::Format::eBc7SrgbBlock;
+}
+
+vk::Format decompressedFormat(vk::Format format)
+{
+    switch (format) {
+    case vk::Format::eBc1RgbaUnormBlock:
+    case vk::Format::eBc2UnormBlock:
+    case vk::Format::eBc3UnormBlock:
+    case vk::Format::eBc4UnormBlock:
+    case vk::Format::eBc5UnormBlock:
+        return vk::Format::eR8G8B8A8Unorm;
+    case vk::Format::eBc1RgbaSrgbBlock:
+    case vk::Format::eBc2SrgbBlock:
+    case vk::Format::eBc3SrgbBlock:
+        return vk::Format::eR8G8B8A8Srgb;
+    case vk::Format::eBc4SnormBlock:
+    case vk::Format::eBc5SnormBlock:
+        return vk::Format::eR8G8B8A8Snorm;
+    case vk::Format::eBc7UnormBlock:
+    case vk::Format::eBc7SrgbBlock:
+        throw std::runtime_error("BC7 textures need a device that can sample BC7, there is no CPU "
+                                 "decoder to fall back to!");
+    default:
+        throw std::runtime_error("No CPU decoder for block compressed format!");
+    }
+}
+
+static void decodeColorBlock(const uint8_t* block, bool allowPunchThrough, uint8_t* texels)
+{
+    uint16_t color0 = static_cast<uint16_t>(block[0] | (block[1] << 8));
+    uint16_t color1 = static_cast<uint16_t>(block[2] | (block[3] << 8));
+    uint32_t indices = block[4] | (block[5] << 8) | (block[6] << 16) | (block[7] << 24);
+
+    uint8_t palette[4][4];
+    for (int i = 0; i < 2; i++) {
+        uint16_t color = i == 0 ? color0 : color1;
+        palette[i][0] = static_cast<uint8_t>(((color >> 11) & 0x1f) * 255 / 31);
+        palette[i][1] = static_cast<uint8_t>(((color >> 5) & 0x3f) * 255 / 63);
+        palette[i][2] = static_cast<uint8_t>((color & 0x1f) * 255 / 31);
+        palette[i][3] = 255;
+    }
+
+    for (int c = 0; c < 3; c++) {
+        if (color0 > color1 || !allowPunchThrough) {
+            palette[2][c] = static_cast<uint8_t>((2 * palette[0][c] + palette[1][c]) / 3);
+            palette[3][c] = static_cast<uint8_t>((palette[0][c] + 2 * palette[1][c]) / 3);
+        } else {
+            palette[2][c] = static_cast<uint8_t>((palette[0][c] + palette[1][c]) / 2);
+            palette[3][c] = 0;
+        }
+    }
+    palette[2][3] = 255;
+    palette[3][3] = color0 > color1 || !allowPunchThrough ? 255 : 0;
+
+    for (int i = 0; i < 16; i++) {
+        memcpy(texels + i * 4, palette[(indices >> (i * 2)) & 0x3], 4);
+    }
+}
+
+// Decodes a BC3/BC4/BC5 style interpolated channel into every fourth byte of texels.
+static void decodeChannelBlock(const uint8_t* block, uint8_t* texels)
+{
+    uint8_t palette[8];
+    palette[0] = block[0];
+    palette[1] = block[1];
+    if (palette[0] > palette[1]) {
+        for (int i = 1; i < 7; i++) {
+            palette[i + 1] = static_cast<uint8_t>(((7 - i) * palette[0] + i * palette[1]) / 7);
+        }
+    } else {
+        for (int i = 1; i < 5; i++) {
+            palette[i + 1] = static_cast<uint8_t>(((5 - i) * palette[0] + i * palette[1]) / 5);
+        }
+        palette[6] = 0;
+        palette[7] = 255;
+    }
+
+    uint64_t indices = 0;
+    for (int i = 0; i < 6; i++) {
+        indices |= static_cast<uint64_t>(block[2 + i]) << (i * 8);
+    }
+
+    for (int i = 0; i < 16; i++) {
+        texels[i * 4] = palette[(indices >> (i * 3)) & 0x7];
+    }
+}
+
+// Decodes a signed BC4/BC5 channel into every fourth byte of texels, as the two's complement
+// bytes R8G8B8A8_SNORM expects. -128 and -127 both stand for -1.0.
+static void decodeSignedChannelBlock(const uint8_t* block, uint8_t* texels)
+{
+    int8_t red0 = static_cast<int8_t>(block[0]);
+    int8_t red1 = static_cast<int8_t>(block[1]);
+
+    int palette[8];
+    palette[0] = std::max<int>(red0, -127);
+    palette[1] = std::max<int>(red1, -127);
+    if (red0 > red1) {
+        for (int i = 1; i < 7; i++) {
+            palette[i + 1] = ((7 - i) * palette[0] + i * palette[1]) / 7;
+        }
+    } else {
+        for (int i = 1; i < 5; i++) {
+            palette[i + 1] = ((5 - i) * palette[0] + i * palette[1]) / 5;
+        }
+        palette[6] = -127;
+        palette[7] = 127;
+    }
+
+    uint64_t indices = 0;
+    for (int i = 0; i < 6; i++) {
+        indices |= static_cast<uint64_t>(block[2 + i]) << (i * 8);
+    }
+
+    for (int i = 0; i < 16; i++) {
+        int value = palette[(indices >> (i * 3)) & 0x7];
+        texels[i * 4] = static_cast<uint8_t>(static_cast<int8_t>(value));
+    }
+}
+
+static void decodeBlock(vk::Format format, const uint8_t* block, uint8_t* texels)
+{
+    switch (format) {
+    case vk::Format::eBc1RgbaUnormBlock:
+    case vk::Format::eBc1RgbaSrgbBlock:
+        decodeColorBlock(block, true, texels);
+        break;
+    case vk::Format::eBc2UnormBlock:
+    case vk::Format::eBc2SrgbBlock:
+        decodeColorBlock(block + 8, false, texels);
+        for (int i = 0; i < 16; i++) {
+            uint8_t alpha = (block[i / 2] >> ((i % 2) * 4)) & 0xf;
+            texels[i * 4 + 3] = static_cast<uint8_t>(alpha * 17);
+        }
+        break;
+    case vk::Format::eBc3UnormBlock:
+    case vk::Format::eBc3SrgbBlock:
+        decodeColorBlock(block + 8, false, texels);
+        decodeChannelBlock(block, texels + 3);
+        break;
+    case vk::Format::eBc4UnormBlock:
+        memset(texels, 0, 64);
+        decodeChannelBlock(block, texels);
+        for (int i = 0; i < 16; i++) {
+            texels[i * 4 + 3] = 255;
+        }
+        break;
+    case vk::Format::eBc5UnormBlock:
+        memset(texels, 0, 64);
+        decodeChannelBlock(block, texels);
+        decodeChannelBlock(block + 8, texels + 1);
+        for (int i = 0; i < 16; i++) {
+            texels[i * 4 + 3] = 255;
+        }
+        break;
+    case vk::Format::eBc4SnormBlock:
+        memset(texels, 0, 64);
+        decodeSignedChannelBlock(block, texels);
+        for (int i = 0; i < 16; i++) {
+            texels[i * 4 + 3] = 127;
+        }
+        break;
+    case vk::Format::eBc5SnormBlock:
+        memset(texels, 0, 64);
+        decodeSignedChannelBlock(block, texels);
+        decodeSignedChannelBlock(block + 8, texels + 1);
+        for (int i = 0; i < 16; i++) {
+            texels[i * 4 + 3] = 127;
+        }
+        break;
+    default:
+        throw std::runtime_error("No CPU decoder for block compressed format!");
+    }
+}
+
+std::vector<char> decompressBlocks(vk::Format format, const char* blocks, vk::Extent3D extent)
+{
+    const uint32_t bytesPerPixel = 4;
+    std::vector<char> pixels(static_cast<size_t>(extent.width) * extent.height * bytesPerPixel);
+
+    uint32_t blocksWide = std::max(1u, (extent.width + 3) / 4);
+    uint32_t blocksHigh = std::max(1u, (extent.height + 3) / 4);
+    const uint8_t* block = reinterpret_cast<const uint8_t*>(blocks);
+
+    for (uint32_t by = 0; by < blocksHigh; by++) {
+        for (uint32_t bx = 0; bx < blocksWide; bx++) {
+            uint8_t texels[16 * 4];
+            decodeBlock(format, block, texels);
+            block += blockSize(format);
+
+            for (uint32_t y = 0; y < 4 && by * 4 + y < extent.height; y++) {
+                for (uint32_t x = 0; x < 4 && bx * 4 + x < extent.width; x++) {
+                    size_t pixel = (by * 4 + y) * extent.width + bx * 4 + x;
+                    memcpy(&pixels[pixel * bytesPerPixel], &texels[(y * 4 + x) * 4], bytesPerPixel);
+                }
+            }
+        }
+    }
+
+    return pixels;
+}
@@ -1,5 +1,6 @@
 #include "../Include/DescriptorManager.h"
 #include "../Include/Device.h"
+#include <algorithm>
 #include <iostream>
 #include <vector>
 #include <vulkan/vulkan.hpp>
@@ -73,6 +74,13 @@ DescriptorManager::DescriptorManager(Device& device) : mDevice(device)
 {
 }
 
+DescriptorManager::~DescriptorManager()
+{
+    for (auto& container : mPipelineLayouts) {
+        static_cast<vk::Device>(mDevice).destroyPipelineLayout(container.layout);
+    }
+}
+
 DescriptorContainer* findDescriptorContainer(
     std::list<DescriptorContainer>& containers, std::vector<vk::DescriptorSetLayoutBinding> bindings)
 {
@@ -84,8 +92,16 @@ DescriptorContainer* findDescriptorContainer(
     return nullptr;
 }
 
-DescriptorSet DescriptorManager::createDescriptorSet(std::vector<vk::DescriptorSetLayoutBinding> bindings)
+DescriptorContainer& DescriptorManager::descriptorContainer(
+    std::vector<vk::DescriptorSetLayoutBinding> bindings)
 {
+    std::sort(
+        bindings.begin(),
+        bindings.end(),
+        [](const vk::DescriptorSetLayoutBinding& a, const vk::DescriptorSetLayoutBinding& b) {
+            return a.binding < b.binding;
+        });
+
     auto container = findDescriptorContainer(mContainers, bindings);
 
     if (!container) {
@@ -93,5 +109,69 @@ DescriptorSet DescriptorManager::createDescriptorSet(std::vector<vk::DescriptorS
         container = &mContainers.emplace_back(mDevice, bindings);
     }
 
-    return DescriptorSet{mDevice, container->bindings(), container->createDescriptorSet(), container->layout()};
+    return *container;
+}
+
+DescriptorSet DescriptorManager::createDescriptorSet(std::vector<vk::DescriptorSetLayoutBinding> bindings)
+{
+    auto& container = descriptorContainer(bindings);
+    return DescriptorSet{mDevice, container.bindings(), container.createDescriptorSet(), container.layout()};
+}
+
+std::shared_ptr<DescriptorSet> DescriptorManager::sharedImageDescriptorSet(
+    std::vector<vk::DescriptorSetLayoutBinding> bindings,
+    uint32_t binding,
+    const vk::DescriptorImageInfo& imageInfo)
+{
+    auto& container = descriptorContainer(bindings);
+
+    mSharedDescriptorSets.erase(
+        std::remove_if(
+            mSharedDescriptorSets.begin(),
+            mSharedDescriptorSets.end(),
+            [](const SharedDescriptorSet& shared) { return shared.descriptorSet.expired(); }),
+        mSharedDescriptorSets.end());
+
+    for (auto& shared : mSharedDescriptorSets) {
+        if (shared.layout == container.layout() && shared.binding == binding &&
+            shared.imageView == imageInfo.imageView && shared.sampler == imageInfo.sampler) {
+            return shared.descriptorSet.lock();
+        }
+    }
+
+    auto descriptorSet = std::make_shared<DescriptorSet>(
+        mDevice, container.bindings(), container.createDescriptorSet(), container.layout());
+    vk::DescriptorImageInfo info = imageInfo;
+    descriptorSet->writeDescriptors({{static_cast<int>(binding), 0, 1, &info}});
+
+    mSharedDescriptorSets.push_back(
+        {container.layout(), binding, imageInfo.imageView, imageInfo.sampler, descriptorSet});
+    return descriptorSet;
+}
+
+vk::DescriptorSetLayout DescriptorManager::descriptorSetLayout(
+    std::vector<vk::DescriptorSetLayoutBinding> bindings)
+{
+    return descriptorContainer(bindings).layout();
+}
+
+vk::PipelineLayout DescriptorManager::pipelineLayout(
+    const std::vector<vk::DescriptorSetLayout>& setLayouts,
+    const std::vector<vk::PushConstantRange>& pushConstantRanges)
+{
+    for (auto& container : mPipelineLayouts) {
+        if (container.setLayouts == setLayouts && container.pushConstantRanges == pushConstantRanges) {
+            return container.layout;
+        }
+    }
+
+    vk::PipelineLayoutCreateInfo pipelineLayoutInfo{};
+    pipelineLayoutInfo.setLayoutCount = static_cast<uint32_t>(setLayouts.size());
+    pipelineLayoutInfo.pSetLayouts = setLayouts.data();
+    pipelineLayoutInfo.pushConstantRangeCount = static_cast<uint32_t>(pushConstantRanges.size());
+    pipelineLayoutInfo.pPushConstantRanges = pushConstantRanges.data();
+
+    vk::PipelineLayout layout = static_cast<vk::Device>(mDevice).createPipelineLayout(pipelineLayoutInfo);
+    mPipelineLayouts.push_back({setLayouts, pushConstantRanges, layout});
+    return layout;
 }
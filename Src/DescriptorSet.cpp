@@ -21,6 +21,17 @@ DescriptorSet::DescriptorSet(
 {
 }
 
+static vk::DescriptorType descriptorType(
+    const std::vector<vk::DescriptorSetLayoutBinding>& bindings, uint32_t binding)
+{
+    for (auto& layoutBinding : bindings) {
+        if (layoutBinding.binding == binding) {
+            return layoutBinding.descriptorType;
+        }
+    }
+    throw std::runtime_error("Descriptor binding not found in layout!");
+}
+
 void DescriptorSet::writeDescriptors(std::vector<DescriptorWrite> descriptorWrites)
 {
     std::vector<vk::WriteDescriptorSet> writes(descriptorWrites.size());
@@ -30,9 +41,10 @@ void DescriptorSet::writeDescriptors(std::vector<DescriptorWrite> descriptorWrit
         writes[i].dstBinding = descriptorWrites[i].binding;
         writes[i].dstArrayElement = descriptorWrites[i].arrayElement;
         writes[i].descriptorCount = descriptorWrites[i].descriptorCount;
-        writes[i].descriptorType = mBindings[descriptorWrites[i].binding].descriptorType;
+        writes[i].descriptorType = descriptorType(mBindings, descriptorWrites[i].binding);
 
-        if (mBindings[descriptorWrites[i].binding].descriptorType == vk::DescriptorType::eUniformBuffer) {
+        if (writes[i].descriptorType == vk::DescriptorType::eUniformBuffer ||
+            writes[i].descriptorType == vk::DescriptorType::eStorageBuffer) {
             writes[i].pBufferInfo = static_cast<vk::DescriptorBufferInfo*>(descriptorWrites[i].infos);
             writes[i].pImageInfo = nullptr;
         } else {
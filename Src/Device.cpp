@@ -233,6 +233,8 @@ vk::Device createLogicalDevice(
 
     vk::PhysicalDeviceFeatures deviceFeatures;
     deviceFeatures.samplerAnisotropy = true;
+    deviceFeatures.textureCompressionBC = physicalDevice.getFeatures().textureCompressionBC;
+    deviceFeatures.multiDrawIndirect = physicalDevice.getFeatures().multiDrawIndirect;
 
     vk::DeviceCreateInfo createInfo(
         {},
@@ -261,6 +263,13 @@ vk::CommandPool createCommandPool(QueueFamilyIndices queueFamilyIndices, vk::Dev
     return commandPool;
 }
 
+vk::PipelineCache createPipelineCache(vk::Device device)
+{
+    vk::PipelineCacheCreateInfo pipelineCacheInfo{};
+    vk::PipelineCache pipelineCache = device.createPipelineCache(pipelineCacheInfo);
+    return pipelineCache;
+}
+
 const std::vector<const char*> validationLayers()
 {
     return {"VK_LAYER_LUNARG_standard_validation"};
@@ -281,12 +290,23 @@ Device::Device(GLFWwindow* window, bool enableValidationLayers)
           mPhysicalDevice, mQueueFamilyIndices, enableValidationLayers, validationLayers(), deviceExtensions())),
       mGraphicsQueue(mDevice.getQueue(mQueueFamilyIndices.graphics, 0)),
       mPresentQueue(mDevice.getQueue(mQueueFamilyIndices.present, 0)),
-      mCommandPool(createCommandPool(mQueueFamilyIndices, mDevice))
+      mCommandPool(createCommandPool(mQueueFamilyIndices, mDevice)),
+      mPipelineCache(createPipelineCache(mDevice)),
+      mShaderLibrary(mDevice),
+      mSamplerCache(mDevice),
+      mPipelineLibrary(mDevice),
+      mThreadPool(defaultThreadCount()),
+      mMultiDrawIndirect(mPhysicalDevice.getFeatures().multiDrawIndirect)
 {
 }
 
 Device::~Device()
 {
+    mThreadPool.shutdown();
+    mPipelineLibrary.clear();
+    mShaderLibrary.clear();
+    mSamplerCache.clear();
+    mDevice.destroyPipelineCache(mPipelineCache);
     mDevice.destroyCommandPool(mCommandPool);
     mDevice.destroy();
     mInstance.destroySurfaceKHR(mSurface);
@@ -60,6 +60,14 @@ static vk::CommandBuffer createCommandBuffer(Device& device)
     return commandBuffer;
 }
 
+static PipelineDescription pipelineDescription()
+{
+    PipelineDescription description{};
+    description.usage = PipelineUsage::ShadowMap;
+    description.vertexShader = "d:/Shaders/shadowvert.spv";
+    return description;
+}
+
 DirectionalLight::DirectionalLight(
     Device& device,
     DescriptorManager& descriptorManager,
@@ -89,7 +97,17 @@ DirectionalLight::DirectionalLight(
           MeshVertex::bindingDescription(),
           MeshVertex::attributeDescriptions(),
           nullptr,
-          {{"vertexShader", "d:/Shaders/shadowvert.spv"}, {"usage", "ShadowMap"}}}
+          pipelineDescription()},
+      mCompressedPipeline{
+          mDevice,
+          descriptorManager,
+          textureManager,
+          swapChain,
+          &mDepthTexture,
+          CompressedMeshVertex::bindingDescription(),
+          CompressedMeshVertex::attributeDescriptions(),
+          nullptr,
+          pipelineDescription()}
 {
     mDepthTexture.transitionLayout(
         vk::ImageLayout::eUndefined, vk::ImageLayout::eDepthStencilAttachmentOptimal);
@@ -114,21 +132,22 @@ void DirectionalLight::drawFrame(std::vector<Mesh>& models, vk::Extent2D swapCha
     renderPassInfo.pClearValues = clearValues.data();
 
     mCommandBuffer.beginRenderPass(renderPassInfo, vk::SubpassContents::eInline);
-    mCommandBuffer.bindPipeline(vk::PipelineBindPoint::eGraphics, mPipeline);
+    setViewportAndScissor(mCommandBuffer, swapChainExtent);
 
+    Pipeline* boundPipeline = nullptr;
     for (Mesh& model : models) {
+        Pipeline& pipeline = model.compressedVertices() ? mCompressedPipeline : mPipeline;
+        if (&pipeline != boundPipeline) {
+            mCommandBuffer.bindPipeline(vk::PipelineBindPoint::eGraphics, pipeline);
+            boundPipeline = &pipeline;
+        }
         mCommandBuffer.bindVertexBuffers(0, {model.vertexBuffer()}, {0});
-        mCommandBuffer.bindIndexBuffer(model.indexBuffer(), 0, vk::IndexType::eUint32);
+        mCommandBuffer.bindIndexBuffer(model.indexBuffer(), 0, model.indexType());
 
-        glm::mat4 worldViewProj = mProjMatrix * viewMatrix() * model.worldMatrix();
-        mCommandBuffer.pushConstants(
-            mPipeline.layout(),
-            vk::ShaderStageFlagBits::eVertex,
-            0,
-            sizeof(float) * 16,
-            &worldViewProj);
+        glm::mat4 worldViewProj = mProjMatrix * viewMatrix() * model.positionWorldMatrix();
+        pipeline.pushConstants(mCommandBuffer, 0, sizeof(float) * 16, &worldViewProj);
 
-        mCommandBuffer.drawIndexed(static_cast<uint32_t>(model.indexCount()), 1, 0, 0, 0);
+        model.drawShadow(mCommandBuffer);
     }
 
     mCommandBuffer.endRenderPass();
@@ -1,5 +1,7 @@
 #include "../Include/Engine.h"
+#include <algorithm>
 #include <fstream>
+#include <map>
 
 GLFWwindow* initWindow(const int width, const int height)
 {
@@ -35,6 +37,7 @@ Engine::Engine(const int width, const int height, const bool enableValidationLay
           vk::SamplerAddressMode::eClampToEdge},
       mDescriptorManager{mDevice},
       mTextureManager{mDevice},
+      mMaterialCache{mDevice, mDescriptorManager, mTextureManager, mSwapChain, mDepthTexture},
       mRenderer{mDevice, mSwapChain, mDepthTexture},
       mSkybox{mDevice, mDescriptorManager, mTextureManager, mSwapChain, mDepthTexture},
       mLight{mDevice, mDescriptorManager, mTextureManager, mSwapChain},
@@ -50,30 +53,132 @@ Engine::~Engine()
 Mesh Engine::createModelFromFile(std::string filename)
 {
     return ::createMeshFromFile(
-        mDevice,
-        mDescriptorManager,
-        mTextureManager,
-        mSwapChain,
-        mDepthTexture,
-        &mLight.depthTexture(),
-        filename);
+        mDevice, mDescriptorManager, &mLight.depthTexture(), mMaterialCache, filename);
+}
+
+// Waits for every job before rethrowing so no job outlives the batch.
+template <typename T>
+static std::vector<T> waitAll(std::vector<std::future<T>>& futures)
+{
+    std::vector<T> results{};
+    std::exception_ptr error{};
+    for (auto& future : futures) {
+        try {
+            results.push_back(future.get());
+        } catch (...) {
+            error = std::current_exception();
+        }
+    }
+    if (error) {
+        std::rethrow_exception(error);
+    }
+    return results;
+}
+
+std::vector<Mesh> Engine::createModelsFromFiles(const std::vector<std::string>& filenames)
+{
+    std::vector<std::future<MeshAsset>> pendingAssets{};
+    for (auto& filename : filenames) {
+        pendingAssets.push_back(
+            mDevice.threadPool().submit([filename]() { return loadMeshAsset(filename); }));
+    }
+    std::vector<MeshAsset> assets = waitAll(pendingAssets);
+
+    // Parses the distinct material files in parallel ahead of mesh creation.
+    std::vector<std::string> materialFilenames{};
+    std::vector<std::future<MaterialHandle>> pendingMaterials{};
+    for (auto& asset : assets) {
+        if (std::find(materialFilenames.begin(), materialFilenames.end(), asset.material) ==
+            materialFilenames.end()) {
+            materialFilenames.push_back(asset.material);
+            pendingMaterials.push_back(mDevice.threadPool().submit(
+                [&materialCache = mMaterialCache, filename = asset.material]() {
+                    return materialCache.load(filename);
+                }));
+        }
+    }
+    std::vector<MaterialHandle> materials = waitAll(pendingMaterials);
+
+    // Packs the small material textures before the material pipelines are created, so they sample
+    // the shared arrays instead of streaming a texture each. Once the pipelines hold their own
+    // references, each array lives until the last pipeline sampling it is destroyed.
+    std::vector<std::string> packedFilenames{};
+    for (MaterialHandle material : materials) {
+        const PipelineDescription& description = mMaterialCache.material(material).description;
+        if (description.texture.empty() ||
+            std::find(packedFilenames.begin(), packedFilenames.end(), description.texture) !=
+                packedFilenames.end()) {
+            continue;
+        }
+        if (Pipeline::samplesPackedTextures(mDevice, description) &&
+            mTextureManager.isPackable(description.texture)) {
+            packedFilenames.push_back(description.texture);
+        }
+    }
+    std::vector<PackedTexture> packedTextures =
+        mTextureManager.packTextures(packedFilenames, vk::SamplerAddressMode::eRepeat);
+    mMaterialCache.createPipelines();
+    for (auto& packed : packedTextures) {
+        mTextureManager.release(packed.texture);
+    }
+
+    std::vector<MeshGeometry> geometry = uploadMeshGeometry(mDevice, mMaterialCache, assets);
+
+    std::vector<Mesh> models{};
+    models.reserve(assets.size());
+    for (size_t i = 0; i < assets.size(); i++) {
+        models.push_back(createMesh(
+            mDevice,
+            mDescriptorManager,
+            &mLight.depthTexture(),
+            mMaterialCache,
+            std::move(assets[i]),
+            std::move(geometry[i])));
+    }
+
+    std::cout << "Scene loaded " << models.size() << " meshes, " << materialFilenames.size()
+              << " materials, " << packedFilenames.size() << " packed textures\n";
+    return models;
 }
 
 void Engine::drawFrame(std::vector<Mesh>& models)
 {
     mCamera.update();
+    mTextureManager.updateStreaming();
+
+    // Textures of the materials closest to the camera stream in first.
+    glm::vec3 cameraPosition{mCamera.worldMatrix()[3]};
     const glm::mat4& world = mLight.worldMatrix();
+    std::map<MaterialHandle, float> texturePriorities{};
     for (Mesh& model : models) {
+        float distance = glm::distance(cameraPosition, glm::vec3{model.worldMatrix()[3]});
+        float& priority = texturePriorities[model.material()];
+        priority = std::max(priority, 1.0f / (1.0f + distance));
+        model.selectLods(
+            cameraPosition, mCamera.projMatrix(), mLight.projMatrix(), mSwapChain.extent());
+        model.cullMeshlets(
+            cameraPosition,
+            mCamera.projMatrix() * mCamera.viewMatrix(),
+            mLight.projMatrix() * mLight.viewMatrix(),
+            mMaterialCache.material(model.material()).description.cullMode);
         model.updateUniformBuffer(
             mCamera.viewMatrix(),
             mCamera.projMatrix(),
             mLight.projMatrix() * mLight.viewMatrix(),
             {world[2][0], world[2][1], world[2][2]});
     }
+    for (auto& priority : texturePriorities) {
+        Pipeline& pipeline = mMaterialCache.pipeline(priority.first);
+        pipeline.setTexturePriority(priority.second);
+        pipeline.updateTexture();
+    }
 
+    mSkybox.pipeline().markTextureUsed();
+    mSkybox.pipeline().updateTexture();
     mSkybox.updateUniformBuffer(glm::mat4(glm::mat3(mCamera.viewMatrix())), mCamera.projMatrix());
     mQuad.updateUniformBuffer();
 
     mLight.drawFrame(models, mSwapChain.extent());
-    mRenderer.drawFrame(models, mSkybox, mQuad, mLight);
+    mRenderer.drawFrame(models, mMaterialCache, mSkybox, mQuad, mLight);
+    mTextureManager.collectGarbage();
 }
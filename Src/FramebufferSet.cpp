@@ -4,7 +4,6 @@
 #include "../Include/Device.h"
 #include "../Include/SwapChain.h"
 #include "../Include/Texture.h"
-#include <iostream>
 #include <vulkan/vulkan.hpp>
 
 FramebufferSet::FramebufferSet(FramebufferSet&& rhs)
@@ -14,8 +13,7 @@ FramebufferSet::FramebufferSet(FramebufferSet&& rhs)
     rhs.mFramebuffers.clear();
 }
 
-vk::RenderPass createRenderPass(
-    Device& device, vk::Format swapChainFormat, const nlohmann::json& json)
+vk::RenderPass createRenderPass(Device& device, vk::Format swapChainFormat, PipelineUsage usage)
 {
     std::vector<vk::AttachmentDescription> attachments{};
 
@@ -24,20 +22,12 @@ vk::RenderPass createRenderPass(
 
     std::vector<vk::AttachmentReference> colorAttachmentRefs{{{0, vk::ImageLayout::eColorAttachmentOptimal}}};
 
-    std::cout << "json size " << json.size() << "\n";
-    if (json.contains("usage")) {
-        std::cout << "usage found\n";
-    } else {
-        std::cout << "usage not found\n";
-        abort();
-    }
-
-    if (json["usage"] != "ShadowMap") {
+    if (usage != PipelineUsage::ShadowMap) {
         vk::AttachmentDescription colorAttachment{};
         colorAttachment.format = swapChainFormat;
         colorAttachment.samples = vk::SampleCountFlagBits::e1;
 
-        if (json["usage"] == "Clear") {
+        if (usage == PipelineUsage::Clear) {
             colorAttachment.loadOp = vk::AttachmentLoadOp::eClear;
         } else {
             colorAttachment.loadOp = vk::AttachmentLoadOp::eLoad;
@@ -47,7 +37,7 @@ vk::RenderPass createRenderPass(
         colorAttachment.stencilLoadOp = vk::AttachmentLoadOp::eDontCare;
         colorAttachment.stencilStoreOp = vk::AttachmentStoreOp::eDontCare;
 
-        if (json["usage"] == "Clear") {
+        if (usage == PipelineUsage::Clear) {
             colorAttachment.initialLayout = vk::ImageLayout::eUndefined;
         } else {
             colorAttachment.initialLayout = vk::ImageLayout::ePresentSrcKHR;
@@ -61,10 +51,10 @@ vk::RenderPass createRenderPass(
         attachments.push_back(colorAttachment);
     }
 
-    if (json["usage"] != "Quad") {
+    if (usage != PipelineUsage::Quad) {
         vk::AttachmentReference depthAttachmentRef{};
 
-        if (json["usage"] != "ShadowMap") {
+        if (usage != PipelineUsage::ShadowMap) {
             depthAttachmentRef.attachment = 1;
             depthAttachmentRef.layout = vk::ImageLayout::eDepthStencilAttachmentOptimal;
         } else {
@@ -78,13 +68,13 @@ vk::RenderPass createRenderPass(
         depthAttachment.format = findDepthAttachmentFormat(device);
         depthAttachment.samples = vk::SampleCountFlagBits::e1;
 
-        if (json["usage"] == "Clear") {
+        if (usage == PipelineUsage::Clear) {
             depthAttachment.loadOp = vk::AttachmentLoadOp::eClear;
         } else {
             depthAttachment.loadOp = vk::AttachmentLoadOp::eLoad;
         }
 
-        if (json["usage"] == "ShadowMap") {
+        if (usage == PipelineUsage::ShadowMap) {
             depthAttachment.loadOp = vk::AttachmentLoadOp::eClear;
         }
 
@@ -92,14 +82,14 @@ vk::RenderPass createRenderPass(
         depthAttachment.stencilLoadOp = vk::AttachmentLoadOp::eDontCare;
         depthAttachment.stencilStoreOp = vk::AttachmentStoreOp::eDontCare;
 
-        if (json["usage"] == "Clear") {
+        if (usage == PipelineUsage::Clear) {
             depthAttachment.initialLayout = vk::ImageLayout::eUndefined;
         } else {
             depthAttachment.initialLayout = vk::ImageLayout::eDepthStencilAttachmentOptimal;
         }
         depthAttachment.finalLayout = vk::ImageLayout::eDepthStencilAttachmentOptimal;
 
-        if (json["usage"] == "ShadowMap") {
+        if (usage == PipelineUsage::ShadowMap) {
             depthAttachment.initialLayout = vk::ImageLayout::eDepthStencilAttachmentOptimal;
             depthAttachment.finalLayout = vk::ImageLayout::eShaderReadOnlyOptimal;
         }
@@ -123,7 +113,6 @@ vk::RenderPass createRenderPass(
     renderPassInfo.dependencyCount = 1;
     renderPassInfo.pDependencies = &dependency;
 
-    std::cout << "attahcment count " << renderPassInfo.attachmentCount << "\n";
     vk::RenderPass renderPass = static_cast<vk::Device>(device).createRenderPass(renderPassInfo, nullptr);
     return renderPass;
 }
@@ -133,9 +122,9 @@ std::vector<vk::Framebuffer> createFramebuffers(
     SwapChain& swapChain,
     Texture* depthTexture,
     vk::RenderPass renderPass,
-    const nlohmann::json& json)
+    PipelineUsage usage)
 {
-    if (json["usage"] == "ShadowMap") {
+    if (usage == PipelineUsage::ShadowMap) {
         std::vector<vk::ImageView> attachments = {depthTexture->imageView()};
 
         vk::FramebufferCreateInfo framebufferInfo{};
@@ -177,10 +166,10 @@ FramebufferSet::FramebufferSet(
     Device& device,
     SwapChain& swapChain,
     Texture* depthTexture,
-    const nlohmann::json& json)
+    PipelineUsage usage)
     : mDevice{device},
-      mRenderPass{createRenderPass(mDevice, swapChain.format(), json)},
-      mFramebuffers{createFramebuffers(mDevice, swapChain, depthTexture, mRenderPass, json)}
+      mRenderPass{createRenderPass(mDevice, swapChain.format(), usage)},
+      mFramebuffers{createFramebuffers(mDevice, swapChain, depthTexture, mRenderPass, usage)}
 {
 }
 
@@ -0,0 +1,76 @@
+#include "../Include/MappedFile.h"
+
+static HANDLE openFile(const std::string& filename)
+{
+    HANDLE file = CreateFileA(
+        filename.c_str(),
+        GENERIC_READ,
+        FILE_SHARE_READ,
+        nullptr,
+        OPEN_EXISTING,
+        FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN,
+        nullptr);
+    if (file == INVALID_HANDLE_VALUE) {
+        throw std::runtime_error("Failed to open file " + filename);
+    }
+    return file;
+}
+
+static size_t fileSize(HANDLE file)
+{
+    LARGE_INTEGER size{};
+    if (!GetFileSizeEx(file, &size)) {
+        CloseHandle(file);
+        throw std::runtime_error("Failed to query file size!");
+    }
+    return static_cast<size_t>(size.QuadPart);
+}
+
+// Empty files cannot be mapped, they are represented by a null mapping instead.
+static HANDLE createMapping(HANDLE file, size_t size)
+{
+    if (size == 0) {
+        return nullptr;
+    }
+
+    HANDLE mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    if (!mapping) {
+        CloseHandle(file);
+        throw std::runtime_error("Failed to create file mapping!");
+    }
+    return mapping;
+}
+
+static const char* mapView(HANDLE file, HANDLE mapping)
+{
+    if (!mapping) {
+        return nullptr;
+    }
+
+    void* data = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+    if (!data) {
+        CloseHandle(mapping);
+        CloseHandle(file);
+        throw std::runtime_error("Failed to map file view!");
+    }
+    return static_cast<const char*>(data);
+}
+
+MappedFile::MappedFile(const std::string& filename)
+    : mFile{openFile(filename)},
+      mSize{fileSize(mFile)},
+      mMapping{createMapping(mFile, mSize)},
+      mData{mapView(mFile, mMapping)}
+{
+}
+
+MappedFile::~MappedFile()
+{
+    if (mData) {
+        UnmapViewOfFile(mData);
+    }
+    if (mMapping) {
+        CloseHandle(mMapping);
+    }
+    CloseHandle(mFile);
+}
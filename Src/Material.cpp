@@ -1,63 +1,96 @@
-/*
 #include "../Include/Material.h"
-#include "../Include/Base.h"
-#include "../Include/DescriptorManager.h"
-#include "../Include/Device.h"
-#include "../Include/TextureManager.h"
-#include <fstream>
-#include <json.hpp>
-
-Material::Material(Material&& rhs)
-    : mDevice{rhs.mDevice}, mTexture{rhs.mTexture}, mDescriptorSet{std::move(rhs.mDescriptorSet)}
+#include "../Include/Mesh.h"
+
+MaterialCache::MaterialCache(
+    Device& device,
+    DescriptorManager& descriptorManager,
+    TextureManager& textureManager,
+    SwapChain& swapChain,
+    Texture& depthTexture)
+    : mDevice{device},
+      mDescriptorManager{descriptorManager},
+      mTextureManager{textureManager},
+      mSwapChain{swapChain},
+      mDepthTexture{depthTexture}
 {
-    rhs.mTexture = nullptr;
 }
 
-DescriptorSet createDescriptorSet(DescriptorManager& descriptorManager, Material& material)
+MaterialCache::~MaterialCache()
 {
-    std::vector<vk::DescriptorSetLayoutBinding> bindings = {
-        {0, vk::DescriptorType::eCombinedImageSampler, 1, vk::ShaderStageFlagBits::eFragment}};
+}
 
-    DescriptorSet descriptorSet = descriptorManager.createDescriptorSet(bindings);
+MaterialHandle MaterialCache::load(const std::string& filename)
+{
+    {
+        std::lock_guard<std::mutex> lock{mMutex};
+        auto it = mMaterialsByFilename.find(filename);
+        if (it != mMaterialsByFilename.end()) {
+            return {it->second};
+        }
+    }
+
+    // Decoding happens outside the lock so workers can load different files concurrently. If
+    // two threads race on the same file the first one to insert wins.
+    auto material = std::make_unique<Material>();
+    material->filename = filename;
+    material->description = loadPipelineDescription(filename);
 
-    if (material.texture()) {
-        vk::DescriptorImageInfo imageInfo{};
-        imageInfo.imageLayout = vk::ImageLayout::eShaderReadOnlyOptimal;
-        imageInfo.imageView = material.texture()->imageView();
-        imageInfo.sampler = material.texture()->sampler();
-        descriptorSet.writeDescriptors({{0, 0, 1, &imageInfo}});
+    std::lock_guard<std::mutex> lock{mMutex};
+    auto it = mMaterialsByFilename.find(filename);
+    if (it != mMaterialsByFilename.end()) {
+        return {it->second};
     }
 
-    return descriptorSet;
+    uint32_t index = static_cast<uint32_t>(mMaterials.size());
+    mMaterials.push_back(std::move(material));
+    mMaterialsByFilename[filename] = index;
+    std::cout << "Material loaded " << filename << "\n";
+    return {index};
 }
 
-Material::Material(
-    Device& device,
-    DescriptorManager& descriptorManager,
-    SwapChain& swapChain,
-    Texture* depthTexture,
-    Texture* texture)
-    : mDevice{device},
-      mTexture{texture},
-      mDescriptorSet{createDescriptorSet(descriptorManager, *this)}
+const Material& MaterialCache::material(MaterialHandle handle) const
 {
+    std::lock_guard<std::mutex> lock{mMutex};
+    if (handle.index >= mMaterials.size()) {
+        throw std::runtime_error("Invalid material handle!");
+    }
+    return *mMaterials[handle.index];
 }
 
-Material::Material(
-    Device& device,
-    DescriptorManager& descriptorManager,
-    TextureManager& textureManager,
-    SwapChain& swapChain,
-    Texture* depthTexture,
-    const nlohmann::json& json)
-    : mDevice{device},
-      mTexture{
-          &textureManager.createTextureFromFile(json["texture"], vk::SamplerAddressMode::eRepeat)},
-      mDescriptorSet{createDescriptorSet(descriptorManager, *this)}
+void MaterialCache::createPipelines()
+{
+    std::lock_guard<std::mutex> lock{mMutex};
+    for (auto& material : mMaterials) {
+        if (material->pipeline) {
+            continue;
+        }
+        bool compressed = material->description.compressedVertices;
+        material->pipeline = std::make_unique<Pipeline>(
+            mDevice,
+            mDescriptorManager,
+            mTextureManager,
+            mSwapChain,
+            &mDepthTexture,
+            compressed ? CompressedMeshVertex::bindingDescription()
+                       : MeshVertex::bindingDescription(),
+            compressed ? CompressedMeshVertex::attributeDescriptions()
+                       : MeshVertex::attributeDescriptions(),
+            mDescriptorManager.descriptorSetLayout(meshDescriptorBindings()),
+            material->description);
+    }
+}
+
+Pipeline& MaterialCache::pipeline(MaterialHandle handle)
 {
+    std::lock_guard<std::mutex> lock{mMutex};
+    if (handle.index >= mMaterials.size() || !mMaterials[handle.index]->pipeline) {
+        throw std::runtime_error("Material has no pipeline!");
+    }
+    return *mMaterials[handle.index]->pipeline;
 }
 
-Material::~Material()
+size_t MaterialCache::size() const
 {
+    std::lock_guard<std::mutex> lock{mMutex};
+    return mMaterials.size();
 }
-*/
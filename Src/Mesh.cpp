@@ -1,111 +1,500 @@
 #include "../Include/Mesh.h"
 #include "../Include/Device.h"
-#include <fstream>
+#include "../Include/MeshFile.h"
+#include "../Include/MeshSimplifier.h"
+#include <algorithm>
+#include <glm/gtc/packing.hpp>
 #include <iostream>
 
+static vk::IndexType indexType(const std::vector<uint32_t>& indices)
+{
+    bool fits16 = std::all_of(
+        indices.begin(), indices.end(), [](uint32_t index) { return index <= 0xffff; });
+    return fits16 ? vk::IndexType::eUint16 : vk::IndexType::eUint32;
+}
+
+static vk::DeviceSize vertexSize(const MeshAsset& asset, bool compressedVertices)
+{
+    size_t stride = compressedVertices ? sizeof(CompressedMeshVertex) : sizeof(MeshVertex);
+    return stride * asset.vertices.size();
+}
+
+static vk::DeviceSize indexSize(const MeshAsset& asset, vk::IndexType type)
+{
+    size_t stride = type == vk::IndexType::eUint16 ? sizeof(uint16_t) : sizeof(uint32_t);
+    return stride * asset.indices.size();
+}
+
+// Writes the vertices, compressing them if the material opts in.
+static void writeVertices(char* data, const MeshAsset& asset, bool compressedVertices)
+{
+    if (compressedVertices) {
+        std::vector<CompressedMeshVertex> compressed =
+            compressVertices(asset.vertices, asset.bounds);
+        memcpy(data, compressed.data(), sizeof(CompressedMeshVertex) * compressed.size());
+    } else {
+        memcpy(data, asset.vertices.data(), sizeof(MeshVertex) * asset.vertices.size());
+    }
+}
+
+static void writeIndices(char* data, const MeshAsset& asset, vk::IndexType type)
+{
+    if (type == vk::IndexType::eUint32) {
+        memcpy(data, asset.indices.data(), sizeof(uint32_t) * asset.indices.size());
+        return;
+    }
+
+    uint16_t* indices16 = reinterpret_cast<uint16_t*>(data);
+    for (size_t i = 0; i < asset.indices.size(); i++) {
+        indices16[i] = static_cast<uint16_t>(asset.indices[i]);
+    }
+}
+
+std::vector<MeshGeometry> uploadMeshGeometry(
+    Device& device, MaterialCache& materialCache, const std::vector<MeshAsset>& assets)
+{
+    if (assets.empty()) {
+        return {};
+    }
+
+    // Keeps every buffer's data aligned for both vertex layouts and 32 bit indices.
+    const vk::DeviceSize alignment = 16;
+
+    std::vector<bool> compressed{};
+    std::vector<vk::IndexType> indexTypes{};
+    std::vector<vk::DeviceSize> vertexOffsets{};
+    std::vector<vk::DeviceSize> indexOffsets{};
+    vk::DeviceSize size = 0;
+    for (auto& asset : assets) {
+        MaterialHandle material = materialCache.load(asset.material);
+        compressed.push_back(materialCache.material(material).description.compressedVertices);
+        indexTypes.push_back(indexType(asset.indices));
+
+        size = (size + alignment - 1) / alignment * alignment;
+        vertexOffsets.push_back(size);
+        size += vertexSize(asset, compressed.back());
+
+        size = (size + alignment - 1) / alignment * alignment;
+        indexOffsets.push_back(size);
+        size += indexSize(asset, indexTypes.back());
+    }
+
+    Buffer stagingBuffer(
+        device,
+        size,
+        vk::BufferUsageFlagBits::eTransferSrc,
+        vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCoherent);
+
+    char* data = static_cast<char*>(stagingBuffer.mapMemory());
+    for (size_t i = 0; i < assets.size(); i++) {
+        writeVertices(data + vertexOffsets[i], assets[i], compressed[i]);
+        writeIndices(data + indexOffsets[i], assets[i], indexTypes[i]);
+    }
+    stagingBuffer.unmapMemory();
+
+    std::vector<MeshGeometry> uploaded{};
+    uploaded.reserve(assets.size());
+
+    vk::CommandBuffer commandBuffer = device.createAndBeginCommandBuffer();
+
+    for (size_t i = 0; i < assets.size(); i++) {
+        vk::DeviceSize vertexBytes = vertexSize(assets[i], compressed[i]);
+        vk::DeviceSize indexBytes = indexSize(assets[i], indexTypes[i]);
+        MeshGeometry& geometry = uploaded.emplace_back(MeshGeometry{
+            Buffer(
+                device,
+                vertexBytes,
+                vk::BufferUsageFlagBits::eTransferDst | vk::BufferUsageFlagBits::eVertexBuffer,
+                vk::MemoryPropertyFlagBits::eDeviceLocal),
+            Buffer(
+                device,
+                indexBytes,
+                vk::BufferUsageFlagBits::eTransferDst | vk::BufferUsageFlagBits::eIndexBuffer,
+                vk::MemoryPropertyFlagBits::eDeviceLocal),
+            compressed[i],
+            indexTypes[i],
+            assets[i].indices.size()});
+
+        commandBuffer.copyBuffer(
+            stagingBuffer, geometry.vertexBuffer, {{vertexOffsets[i], 0, vertexBytes}});
+        commandBuffer.copyBuffer(
+            stagingBuffer, geometry.indexBuffer, {{indexOffsets[i], 0, indexBytes}});
+    }
+
+    device.flushAndFreeCommandBuffer(commandBuffer);
+    return uploaded;
+}
+
+static Buffer createUniformBuffer(Device& device)
+{
+    return Buffer(
+        device,
+        sizeof(MeshUniform),
+        vk::BufferUsageFlagBits::eUniformBuffer,
+        vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCoherent);
+}
+
+std::vector<vk::DescriptorSetLayoutBinding> meshDescriptorBindings()
+{
+    return {
+        {0,
+         vk::DescriptorType::eUniformBuffer,
+         1,
+         vk::ShaderStageFlagBits::eVertex | vk::ShaderStageFlagBits::eFragment},
+        {1, vk::DescriptorType::eCombinedImageSampler, 1, vk::ShaderStageFlagBits::eFragment}};
+}
+
+static DescriptorSet createDescriptorSet(
+    DescriptorManager& descriptorManager, vk::Buffer uniformBuffer, Texture* shadowMap)
+{
+    DescriptorSet descriptorSet = descriptorManager.createDescriptorSet(meshDescriptorBindings());
+
+    vk::DescriptorBufferInfo bufferInfo;
+    bufferInfo.buffer = uniformBuffer;
+    bufferInfo.offset = 0;
+    bufferInfo.range = sizeof(MeshUniform);
+    descriptorSet.writeDescriptors({{0, 0, 1, &bufferInfo}});
+
+    if (shadowMap) {
+        vk::DescriptorImageInfo imageInfo{};
+        imageInfo.imageLayout = vk::ImageLayout::eShaderReadOnlyOptimal;
+        imageInfo.imageView = shadowMap->imageView();
+        imageInfo.sampler = shadowMap->sampler();
+        descriptorSet.writeDescriptors({{1, 0, 1, &imageInfo}});
+    }
+
+    return descriptorSet;
+}
+
+// Meshlets are built LOD by LOD, so the meshlets of LOD i are [offsets[i], offsets[i + 1]).
+static std::vector<size_t> lodMeshlets(
+    const std::vector<MeshLod>& lods, const std::vector<Meshlet>& meshlets)
+{
+    std::vector<size_t> offsets(lods.size() + 1, meshlets.size());
+    size_t meshlet = 0;
+    for (size_t i = 0; i < lods.size(); i++) {
+        while (meshlet < meshlets.size() && meshlets[meshlet].firstIndex < lods[i].firstIndex) {
+            meshlet++;
+        }
+        offsets[i] = meshlet;
+    }
+    return offsets;
+}
+
+static uint32_t maxDrawCount(const std::vector<size_t>& lodMeshlets)
+{
+    size_t count = 1;
+    for (size_t i = 0; i + 1 < lodMeshlets.size(); i++) {
+        count = std::max(count, lodMeshlets[i + 1] - lodMeshlets[i]);
+    }
+    return static_cast<uint32_t>(count);
+}
+
 Mesh::Mesh(
     Device& device,
     DescriptorManager& descriptorManager,
-    TextureManager& textureManager,
-    SwapChain& swapChain,
-    Texture& depthTexture,
     glm::mat4 worldMatrix,
-    std::vector<Vertex> vertices,
-    std::vector<uint32_t> indices,
-    const nlohmann::json& json,
+    MeshGeometry geometry,
     Texture* shadowMap,
-    std::vector<glm::mat4> keyframes)
-    : Object{
+    std::vector<glm::mat4> keyframes,
+    std::vector<MeshLod> lods,
+    MeshBounds bounds,
+    std::vector<Meshlet> meshlets,
+    MaterialHandle material)
+    : mDevice{device},
+      mCompressedVertices{geometry.compressedVertices},
+      mWorldMatrix{worldMatrix},
+      mPositionDecode{
+          geometry.compressedVertices ? positionDecodeMatrix(bounds) : glm::mat4{1.0f}},
+      mVertexBuffer{std::move(geometry.vertexBuffer)},
+      mIndexBuffer{std::move(geometry.indexBuffer)},
+      mUniformBuffer{createUniformBuffer(mDevice)},
+      mUniform{},
+      mDescriptorSet{createDescriptorSet(descriptorManager, mUniformBuffer, shadowMap)},
+      mKeyframes{std::move(keyframes)},
+      mIndexType{geometry.indexType},
+      mIndexCount{geometry.indexCount},
+      mLods{std::move(lods)},
+      mBounds{bounds},
+      mLod{0},
+      mShadowLod{0},
+      mMeshlets{std::move(meshlets)},
+      mMeshletBounds{meshletBounds(mMeshlets)},
+      mLodMeshlets{lodMeshlets(mLods, mMeshlets)},
+      mMaxDrawCount{maxDrawCount(mLodMeshlets)},
+      mDrawBuffer{
           device,
-          descriptorManager,
-          textureManager,
-          swapChain,
-          depthTexture,
-          worldMatrix,
-          vertices,
-          indices,
-          json,
-          shadowMap,
-          keyframes}
+          2 * mMaxDrawCount * sizeof(vk::DrawIndexedIndirectCommand),
+          vk::BufferUsageFlagBits::eIndirectBuffer,
+          vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCoherent},
+      mDraws{static_cast<vk::DrawIndexedIndirectCommand*>(mDrawBuffer.mapMemory())},
+      mDrawCount{0},
+      mShadowDrawCount{0},
+      mMultiDrawIndirect{device.multiDrawIndirect()},
+      mMaterial{material}
 {
 }
 
-Mesh createMeshFromFile(
-    Device& device,
-    DescriptorManager& descriptorManager,
-    TextureManager& textureManager,
-    SwapChain& swapChain,
-    Texture& depthTexture,
-    Texture* shadowMap,
-    std::string filename)
+void Mesh::updateUniformBuffer(
+    const glm::mat4& viewMatrix,
+    const glm::mat4& projMatrix,
+    const glm::mat4& lightSpaceMatrix,
+    const glm::vec3& lightDir)
 {
-    std::ifstream file(filename, std::ios::in | std::ios::binary);
-    if (!file.is_open()) {
-        throw std::runtime_error("Failed to open mesh file!");
+    mUniform.world = positionWorldMatrix();
+    mUniform.normalWorld = mWorldMatrix;
+    mUniform.view = viewMatrix;
+    mUniform.proj = projMatrix;
+    mUniform.lightSpace = lightSpaceMatrix;
+    mUniform.lightDir = lightDir;
+    void* data = mUniformBuffer.mapMemory();
+    memcpy(data, &mUniform, sizeof(MeshUniform));
+    mUniformBuffer.unmapMemory();
+}
+
+// Largest simplification error, in pixels, a LOD may show before a finer one is used.
+const float lodPixelError = 1.0f;
+
+// Coarsest LOD whose error stays under lodPixelError when the bounding sphere of the given world
+// radius covers projectedRadius pixels.
+static size_t selectLod(
+    const std::vector<MeshLod>& lods, float radius, float scale, float projectedRadius)
+{
+    size_t lod = 0;
+    for (size_t i = 1; i < lods.size(); i++) {
+        if (lods[i].error * scale / radius * projectedRadius > lodPixelError) {
+            break;
+        }
+        lod = i;
+    }
+    return lod;
+}
+
+void Mesh::selectLods(
+    const glm::vec3& cameraPosition,
+    const glm::mat4& projMatrix,
+    const glm::mat4& lightProjMatrix,
+    vk::Extent2D extent)
+{
+    const glm::mat4& world = worldMatrix();
+    float scale = std::max(
+        {glm::length(glm::vec3{world[0]}),
+         glm::length(glm::vec3{world[1]}),
+         glm::length(glm::vec3{world[2]})});
+    glm::vec3 center{world * glm::vec4{(mBounds.min + mBounds.max) * 0.5f, 1.0f}};
+    float radius = std::max(glm::length(mBounds.max - mBounds.min) * 0.5f * scale, 1e-6f);
+
+    float halfHeight = extent.height * 0.5f;
+    float distance = glm::distance(cameraPosition, center) - radius;
+    if (distance <= 0.0f) {
+        mLod = 0;
+    } else {
+        float projectedRadius = radius * std::abs(projMatrix[1][1]) * halfHeight / distance;
+        mLod = selectLod(mLods, radius, scale, projectedRadius);
+    }
+
+    float shadowProjectedRadius = radius * std::abs(lightProjMatrix[1][1]) * halfHeight;
+    mShadowLod = selectLod(mLods, radius, scale, shadowProjectedRadius);
+}
+
+void Mesh::cullMeshlets(
+    const glm::vec3& cameraPosition,
+    const glm::mat4& viewProjMatrix,
+    const glm::mat4& lightViewProjMatrix,
+    vk::CullModeFlags cullMode)
+{
+    // Culling happens in model space so the meshlet bounds never need transforming.
+    const glm::mat4& world = worldMatrix();
+    glm::vec3 viewPosition{glm::inverse(world) * glm::vec4{cameraPosition, 1.0f}};
+    bool coneCulling = cullMode == vk::CullModeFlagBits::eBack;
+
+    mDrawCount = ::cullMeshlets(
+        mMeshlets,
+        mMeshletBounds,
+        mLodMeshlets[mLod],
+        mLodMeshlets[mLod + 1] - mLodMeshlets[mLod],
+        frustumPlanes(viewProjMatrix * world),
+        viewPosition,
+        coneCulling,
+        mDraws);
+
+    mShadowDrawCount = ::cullMeshlets(
+        mMeshlets,
+        mMeshletBounds,
+        mLodMeshlets[mShadowLod],
+        mLodMeshlets[mShadowLod + 1] - mLodMeshlets[mShadowLod],
+        frustumPlanes(lightViewProjMatrix * world),
+        viewPosition,
+        false,
+        mDraws + mMaxDrawCount);
+}
+
+void Mesh::draw(vk::CommandBuffer commandBuffer) const
+{
+    drawIndirect(commandBuffer, 0, mDrawCount);
+}
+
+void Mesh::drawShadow(vk::CommandBuffer commandBuffer) const
+{
+    drawIndirect(commandBuffer, mMaxDrawCount, mShadowDrawCount);
+}
+
+// Without the multiDrawIndirect feature every draw needs its own command.
+void Mesh::drawIndirect(
+    vk::CommandBuffer commandBuffer, uint32_t firstDraw, uint32_t drawCount) const
+{
+    const uint32_t stride = sizeof(vk::DrawIndexedIndirectCommand);
+    if (mMultiDrawIndirect) {
+        if (drawCount > 0) {
+            commandBuffer.drawIndexedIndirect(mDrawBuffer, firstDraw * stride, drawCount, stride);
+        }
+    } else {
+        for (uint32_t i = 0; i < drawCount; i++) {
+            commandBuffer.drawIndexedIndirect(mDrawBuffer, (firstDraw + i) * stride, 1, stride);
+        }
+    }
+}
+
+static glm::vec3 boundsExtent(const MeshBounds& bounds)
+{
+    // Flat meshes would otherwise divide by zero on their flat axis.
+    return glm::max(bounds.max - bounds.min, glm::vec3{1e-6f});
+}
+
+// Folds the lower hemisphere over the diagonals so unit vectors map onto the [-1, 1] square.
+static glm::vec2 encodeOctahedral(glm::vec3 normal)
+{
+    normal /= std::abs(normal.x) + std::abs(normal.y) + std::abs(normal.z);
+    glm::vec2 encoded{normal.x, normal.y};
+    if (normal.z < 0.0f) {
+        encoded = (1.0f - glm::abs(glm::vec2{normal.y, normal.x})) *
+            glm::vec2{normal.x >= 0.0f ? 1.0f : -1.0f, normal.y >= 0.0f ? 1.0f : -1.0f};
     }
+    return encoded;
+}
+
+std::vector<CompressedMeshVertex> compressVertices(
+    const std::vector<MeshVertex>& vertices, const MeshBounds& bounds)
+{
+    glm::vec3 extent = boundsExtent(bounds);
+
+    std::vector<CompressedMeshVertex> compressed(vertices.size());
+    for (size_t i = 0; i < vertices.size(); i++) {
+        const MeshVertex& vertex = vertices[i];
 
-    std::string header = readString(file);
-    if (header != "paskaformaatti 1.0") {
-        std::cout << "HEADER\n";
-        throw std::runtime_error("Header file not matching!");
+        glm::vec3 unorm = glm::clamp((vertex.position - bounds.min) / extent, 0.0f, 1.0f);
+        for (int c = 0; c < 3; c++) {
+            compressed[i].position[c] = static_cast<uint16_t>(std::round(unorm[c] * 65535.0f));
+        }
+        compressed[i].position[3] = 65535;
+
+        glm::vec3 normal = vertex.normal;
+        glm::vec2 octahedral{0.0f};
+        if (glm::length(normal) > 0.0f) {
+            octahedral = encodeOctahedral(normal);
+        }
+        for (int c = 0; c < 2; c++) {
+            compressed[i].normal[c] =
+                static_cast<int16_t>(std::round(glm::clamp(octahedral[c], -1.0f, 1.0f) * 32767.0f));
+        }
+
+        compressed[i].texCoord[0] = glm::packHalf1x16(vertex.texCoord.x);
+        compressed[i].texCoord[1] = glm::packHalf1x16(vertex.texCoord.y);
     }
 
-    glm::mat4 worldMatrix;
-    file.read(reinterpret_cast<char*>(&worldMatrix), sizeof(glm::mat4));
+    return compressed;
+}
+
+glm::mat4 positionDecodeMatrix(const MeshBounds& bounds)
+{
+    return glm::scale(glm::translate(glm::mat4{1.0f}, bounds.min), boundsExtent(bounds));
+}
+
+MeshAsset loadMeshAsset(const std::string& filename)
+{
+    MeshData mesh = readMeshFile(filename);
 
-    uint32_t vertexCount = readInt(file);
-    std::cout << "vertex count " << vertexCount << std::endl;
-    //std::vector<ModelVertex> vertices(vertexCount);
-    //for (ModelVertex& vertex : vertices) {
-    std::vector<Vertex> vertices(vertexCount);
-    for (Vertex& vertex : vertices) {
-        vertex.position.x = readFloat(file);
-        vertex.position.y = readFloat(file);
-        vertex.position.z = readFloat(file);
-        vertex.normal.x = readFloat(file);
-        vertex.normal.y = readFloat(file);
-        vertex.normal.z = readFloat(file);
-        vertex.texCoord.x = readFloat(file);
-        vertex.texCoord.y = readFloat(file);
+    // Files cooked by MeshConverter already carry their LODs.
+    if (mesh.lods.size() == 1) {
+        generateLods(mesh);
     }
 
-    uint32_t indexCount = readInt(file);
-    std::cout << "index count " << indexCount << std::endl;
-    std::vector<uint32_t> indices(indexCount);
-    for (uint32_t& index : indices) {
-        index = readInt(file);
+    MeshAsset asset{};
+    asset.worldMatrix = mesh.worldMatrix;
+
+    asset.vertices.resize(mesh.vertices.size());
+    for (size_t i = 0; i < asset.vertices.size(); i++) {
+        const MeshFileVertex& fileVertex = mesh.vertices[i];
+        asset.vertices[i].position =
+            glm::vec3{fileVertex.position[0], fileVertex.position[1], fileVertex.position[2]};
+        asset.vertices[i].normal =
+            glm::vec3{fileVertex.normal[0], fileVertex.normal[1], fileVertex.normal[2]};
+        asset.vertices[i].texCoord = glm::vec2{fileVertex.texCoord[0], fileVertex.texCoord[1]};
     }
 
-    auto materialFilename = readString(file);
-    using Json = nlohmann::json;
-    std::ifstream materialFile{materialFilename};
-    if (!file.is_open()) {
-        throw std::runtime_error("Failed to open material file!");
+    for (auto& lod : mesh.lods) {
+        std::vector<Meshlet> levelMeshlets = buildMeshlets(
+            mesh.indices.data() + lod.firstIndex, lod.indexCount, lod.firstIndex, mesh.vertices);
+        asset.meshlets.insert(asset.meshlets.end(), levelMeshlets.begin(), levelMeshlets.end());
     }
-    Json json;
-    materialFile >> json;
 
-    auto keyframeCount = readInt(file);
-    std::cout << "keyframeCount " << keyframeCount << "\n";
-    std::vector<glm::mat4> keyframes(keyframeCount);
-    for (auto i = 0; i < keyframeCount; ++i) {
-        file.read(reinterpret_cast<char*>(&keyframes[i]), sizeof(glm::mat4));
-        keyframes[i][3][0] *= 0.001f;
-        keyframes[i][3][1] *= 0.001f;
-        keyframes[i][3][2] *= 0.001f;
+    for (auto& keyframe : mesh.keyframes) {
+        keyframe[3][0] *= 0.001f;
+        keyframe[3][1] *= 0.001f;
+        keyframe[3][2] *= 0.001f;
     }
 
-    file.close();
+    asset.indices = std::move(mesh.indices);
+    asset.lods = std::move(mesh.lods);
+    asset.bounds = mesh.bounds;
+    asset.keyframes = std::move(mesh.keyframes);
+    asset.material = std::move(mesh.material);
+    return asset;
+}
+
+Mesh createMesh(
+    Device& device,
+    DescriptorManager& descriptorManager,
+    Texture* shadowMap,
+    MaterialCache& materialCache,
+    MeshAsset asset,
+    MeshGeometry geometry)
+{
+    MaterialHandle material = materialCache.load(asset.material);
+    materialCache.createPipelines();
+
+    std::cout << "vertex count " << asset.vertices.size() << std::endl;
+    std::cout << "index count " << asset.indices.size() << std::endl;
+    std::cout << "keyframeCount " << asset.keyframes.size() << "\n";
+
     return Mesh{
         device,
         descriptorManager,
-        textureManager,
-        swapChain,
-        depthTexture,
-        worldMatrix,
-        vertices,
-        indices,
-        json,
+        asset.worldMatrix,
+        std::move(geometry),
+        shadowMap,
+        std::move(asset.keyframes),
+        std::move(asset.lods),
+        asset.bounds,
+        std::move(asset.meshlets),
+        material};
+}
+
+Mesh createMeshFromFile(
+    Device& device,
+    DescriptorManager& descriptorManager,
+    Texture* shadowMap,
+    MaterialCache& materialCache,
+    std::string filename)
+{
+    std::vector<MeshAsset> assets{};
+    assets.push_back(loadMeshAsset(filename));
+    std::vector<MeshGeometry> geometry = uploadMeshGeometry(device, materialCache, assets);
+    return createMesh(
+        device,
+        descriptorManager,
         shadowMap,
-        keyframes};
+        materialCache,
+        std::move(assets[0]),
+        std::move(geometry[0]));
 }
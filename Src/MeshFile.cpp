@@ -0,0 +1,281 @@
+#include "../Include/MeshFile.h"
+#include "../Include/MappedFile.h"
+#include <algorithm>
+#include <fstream>
+
+const uint32_t meshFileMagic = 0x4853454d; // "MESH"
+const uint32_t meshFileVersion = 2;
+
+// Payloads start on multiples of this so they can be copied into buffers without realignment.
+const size_t meshChunkAlignment = 16;
+
+static uint32_t chunkId(const char* code)
+{
+    return static_cast<uint32_t>(code[0]) | (static_cast<uint32_t>(code[1]) << 8) |
+        (static_cast<uint32_t>(code[2]) << 16) | (static_cast<uint32_t>(code[3]) << 24);
+}
+
+const uint32_t transformChunk = chunkId("XFRM");
+const uint32_t vertexChunk = chunkId("VERT");
+const uint32_t indexChunk = chunkId("INDX");
+const uint32_t boundsChunk = chunkId("BNDS");
+const uint32_t lodChunk = chunkId("LODS");
+const uint32_t keyframeChunk = chunkId("KEYF");
+const uint32_t materialChunk = chunkId("MATL");
+
+struct MeshChunk {
+    uint32_t id;
+    uint32_t checksum;
+    uint64_t offset;
+    uint64_t size;
+};
+
+static uint32_t checksum(const char* data, size_t size)
+{
+    uint32_t hash = 2166136261u;
+    for (size_t i = 0; i < size; i++) {
+        hash ^= static_cast<uint8_t>(data[i]);
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+MeshBounds meshBounds(const std::vector<MeshFileVertex>& vertices)
+{
+    MeshBounds bounds{glm::vec3{0.0f}, glm::vec3{0.0f}};
+    for (size_t i = 0; i < vertices.size(); i++) {
+        glm::vec3 position{
+            vertices[i].position[0], vertices[i].position[1], vertices[i].position[2]};
+        bounds.min = i == 0 ? position : glm::min(bounds.min, position);
+        bounds.max = i == 0 ? position : glm::max(bounds.max, position);
+    }
+    return bounds;
+}
+
+struct MeshFileReader {
+    const MappedFile& file;
+    size_t offset;
+
+    const char* take(size_t size)
+    {
+        if (size > file.size() - offset) {
+            throw std::runtime_error("Truncated mesh file!");
+        }
+        const char* data = file.data() + offset;
+        offset += size;
+        return data;
+    }
+
+    template <typename T>
+    T read()
+    {
+        T value{};
+        memcpy(&value, take(sizeof(T)), sizeof(T));
+        return value;
+    }
+
+    // Legacy strings are a length followed by that many bytes, possibly NUL padded.
+    std::string readString()
+    {
+        uint32_t length = read<uint32_t>();
+        const char* data = take(length);
+        return std::string{data, strnlen(data, length)};
+    }
+
+    template <typename T>
+    std::vector<T> readArray(size_t count)
+    {
+        std::vector<T> values(count);
+        memcpy(values.data(), take(count * sizeof(T)), count * sizeof(T));
+        return values;
+    }
+};
+
+// Everything downstream indexes vertices and walks whole triangles without further checks.
+static void validateIndices(const MeshData& mesh, const std::string& filename)
+{
+    if (mesh.indices.size() % 3 != 0) {
+        throw std::runtime_error("Mesh indices are not whole triangles: " + filename);
+    }
+    for (uint32_t index : mesh.indices) {
+        if (index >= mesh.vertices.size()) {
+            throw std::runtime_error("Mesh index out of bounds: " + filename);
+        }
+    }
+}
+
+static MeshData readLegacyMeshFile(const MappedFile& file, const std::string& filename)
+{
+    MeshFileReader reader{file, 0};
+
+    if (reader.readString() != "paskaformaatti 1.0") {
+        throw std::runtime_error("Header file not matching!");
+    }
+
+    MeshData mesh{};
+    mesh.worldMatrix = reader.read<glm::mat4>();
+    mesh.vertices = reader.readArray<MeshFileVertex>(reader.read<uint32_t>());
+    mesh.indices = reader.readArray<uint32_t>(reader.read<uint32_t>());
+    mesh.material = reader.readString();
+    mesh.keyframes = reader.readArray<glm::mat4>(reader.read<uint32_t>());
+    validateIndices(mesh, filename);
+    mesh.bounds = meshBounds(mesh.vertices);
+    mesh.lods.push_back({0, static_cast<uint32_t>(mesh.indices.size()), 0.0f});
+    return mesh;
+}
+
+static const MeshChunk* findChunk(const std::vector<MeshChunk>& chunks, uint32_t id)
+{
+    auto it = std::find_if(
+        chunks.begin(), chunks.end(), [id](const MeshChunk& chunk) { return chunk.id == id; });
+    return it != chunks.end() ? &*it : nullptr;
+}
+
+template <typename T>
+static std::vector<T> readChunkArray(const MappedFile& file, const MeshChunk& chunk)
+{
+    if (chunk.size % sizeof(T) != 0) {
+        throw std::runtime_error("Mesh chunk size is not a whole number of elements!");
+    }
+    std::vector<T> values(chunk.size / sizeof(T));
+    memcpy(values.data(), file.data() + chunk.offset, chunk.size);
+    return values;
+}
+
+MeshData readMeshFile(const std::string& filename)
+{
+    MappedFile file{filename};
+    MeshFileReader reader{file, 0};
+
+    if (file.size() < sizeof(uint32_t) || reader.read<uint32_t>() != meshFileMagic) {
+        return readLegacyMeshFile(file, filename);
+    }
+    if (reader.read<uint32_t>() != meshFileVersion) {
+        throw std::runtime_error("Unsupported mesh file version: " + filename);
+    }
+
+    uint32_t chunkCount = reader.read<uint32_t>();
+    reader.read<uint32_t>();
+
+    std::vector<MeshChunk> chunks = reader.readArray<MeshChunk>(chunkCount);
+    for (auto& chunk : chunks) {
+        if (chunk.offset > file.size() || chunk.size > file.size() - chunk.offset) {
+            throw std::runtime_error("Mesh chunk out of bounds: " + filename);
+        }
+        if (checksum(file.data() + chunk.offset, chunk.size) != chunk.checksum) {
+            throw std::runtime_error("Mesh chunk checksum mismatch: " + filename);
+        }
+    }
+
+    auto vertices = findChunk(chunks, vertexChunk);
+    auto indices = findChunk(chunks, indexChunk);
+    if (!vertices || !indices) {
+        throw std::runtime_error("Mesh file has no geometry: " + filename);
+    }
+
+    MeshData mesh{};
+    mesh.vertices = readChunkArray<MeshFileVertex>(file, *vertices);
+    mesh.indices = readChunkArray<uint32_t>(file, *indices);
+    validateIndices(mesh, filename);
+
+    mesh.worldMatrix = glm::mat4{1.0f};
+    if (auto transform = findChunk(chunks, transformChunk)) {
+        mesh.worldMatrix = readChunkArray<glm::mat4>(file, *transform).at(0);
+    }
+
+    if (auto bounds = findChunk(chunks, boundsChunk)) {
+        mesh.bounds = readChunkArray<MeshBounds>(file, *bounds).at(0);
+    } else {
+        mesh.bounds = meshBounds(mesh.vertices);
+    }
+
+    if (auto lods = findChunk(chunks, lodChunk)) {
+        mesh.lods = readChunkArray<MeshLod>(file, *lods);
+    }
+    if (mesh.lods.empty()) {
+        mesh.lods.push_back({0, static_cast<uint32_t>(mesh.indices.size()), 0.0f});
+    }
+    for (auto& lod : mesh.lods) {
+        if (static_cast<uint64_t>(lod.firstIndex) + lod.indexCount > mesh.indices.size()) {
+            throw std::runtime_error("Mesh LOD out of bounds: " + filename);
+        }
+    }
+
+    if (auto keyframes = findChunk(chunks, keyframeChunk)) {
+        mesh.keyframes = readChunkArray<glm::mat4>(file, *keyframes);
+    }
+    if (auto material = findChunk(chunks, materialChunk)) {
+        mesh.material = std::string{file.data() + material->offset, material->size};
+    }
+
+    return mesh;
+}
+
+struct ChunkPayload {
+    uint32_t id;
+    const char* data;
+    size_t size;
+};
+
+template <typename T>
+static ChunkPayload payload(uint32_t id, const std::vector<T>& values)
+{
+    return {id, reinterpret_cast<const char*>(values.data()), values.size() * sizeof(T)};
+}
+
+template <typename T>
+static ChunkPayload payload(uint32_t id, const T& value)
+{
+    return {id, reinterpret_cast<const char*>(&value), sizeof(T)};
+}
+
+static size_t alignChunk(size_t offset)
+{
+    return (offset + meshChunkAlignment - 1) / meshChunkAlignment * meshChunkAlignment;
+}
+
+template <typename T>
+static void write(std::ofstream& file, T value)
+{
+    file.write(reinterpret_cast<const char*>(&value), sizeof(T));
+}
+
+void writeMeshFile(const std::string& filename, const MeshData& mesh)
+{
+    std::vector<ChunkPayload> payloads = {
+        payload(transformChunk, mesh.worldMatrix),
+        payload(vertexChunk, mesh.vertices),
+        payload(indexChunk, mesh.indices),
+        payload(boundsChunk, mesh.bounds),
+        payload(lodChunk, mesh.lods),
+        payload(keyframeChunk, mesh.keyframes),
+        {materialChunk, mesh.material.data(), mesh.material.size()}};
+
+    std::vector<MeshChunk> chunks{};
+    size_t offset = 4 * sizeof(uint32_t) + payloads.size() * sizeof(MeshChunk);
+    for (auto& payload : payloads) {
+        offset = alignChunk(offset);
+        chunks.push_back({payload.id, checksum(payload.data, payload.size), offset, payload.size});
+        offset += payload.size;
+    }
+
+    std::ofstream file(filename, std::ios::out | std::ios::binary);
+    if (!file.is_open()) {
+        throw std::runtime_error("Failed to open mesh file for writing!");
+    }
+
+    write(file, meshFileMagic);
+    write(file, meshFileVersion);
+    write(file, static_cast<uint32_t>(chunks.size()));
+    write(file, uint32_t{0});
+    for (auto& chunk : chunks) {
+        write(file, chunk);
+    }
+
+    const char zeros[meshChunkAlignment] = {};
+    for (size_t i = 0; i < payloads.size(); i++) {
+        size_t position = static_cast<size_t>(file.tellp());
+        file.write(zeros, chunks[i].offset - position);
+        file.write(payloads[i].data, payloads[i].size);
+    }
+}
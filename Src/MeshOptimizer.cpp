@@ -0,0 +1,338 @@
+#include "../Include/MeshOptimizer.h"
+#include <algorithm>
+#include <cmath>
+#include <unordered_map>
+
+// Cache size the Forsyth scores are tuned for, larger than any real post-transform cache so the
+// ordering degrades gracefully on all of them.
+const size_t forsythCacheSize = 32;
+
+VertexCacheStatistics analyzeVertexCache(
+    const uint32_t* indices, size_t indexCount, size_t vertexCount, uint32_t cacheSize)
+{
+    std::vector<uint32_t> cache{};
+    std::vector<bool> referenced(vertexCount, false);
+    uint32_t misses = 0;
+    uint32_t uniqueVertices = 0;
+
+    for (size_t i = 0; i < indexCount; i++) {
+        uint32_t index = indices[i];
+        if (!referenced[index]) {
+            referenced[index] = true;
+            uniqueVertices++;
+        }
+
+        if (std::find(cache.begin(), cache.end(), index) == cache.end()) {
+            misses++;
+            cache.push_back(index);
+            if (cache.size() > cacheSize) {
+                cache.erase(cache.begin());
+            }
+        }
+    }
+
+    VertexCacheStatistics statistics{};
+    statistics.misses = misses;
+    statistics.acmr = indexCount > 0 ? misses / (indexCount / 3.0f) : 0.0f;
+    statistics.atvr = uniqueVertices > 0 ? static_cast<float>(misses) / uniqueVertices : 0.0f;
+    return statistics;
+}
+
+struct VertexHash {
+    size_t operator()(const MeshFileVertex& vertex) const
+    {
+        const uint8_t* bytes = reinterpret_cast<const uint8_t*>(&vertex);
+        size_t hash = 14695981039346656037ull;
+        for (size_t i = 0; i < sizeof(MeshFileVertex); i++) {
+            hash ^= bytes[i];
+            hash *= 1099511628211ull;
+        }
+        return hash;
+    }
+};
+
+struct VertexEqual {
+    bool operator()(const MeshFileVertex& a, const MeshFileVertex& b) const
+    {
+        return memcmp(&a, &b, sizeof(MeshFileVertex)) == 0;
+    }
+};
+
+void deduplicateVertices(MeshData& mesh)
+{
+    std::unordered_map<MeshFileVertex, uint32_t, VertexHash, VertexEqual> unique{};
+    std::vector<MeshFileVertex> vertices{};
+    std::vector<uint32_t> remap(mesh.vertices.size());
+
+    for (size_t i = 0; i < mesh.vertices.size(); i++) {
+        auto result =
+            unique.emplace(mesh.vertices[i], static_cast<uint32_t>(vertices.size()));
+        if (result.second) {
+            vertices.push_back(mesh.vertices[i]);
+        }
+        remap[i] = result.first->second;
+    }
+
+    for (auto& index : mesh.indices) {
+        index = remap[index];
+    }
+    mesh.vertices = std::move(vertices);
+}
+
+static float vertexScore(int cachePosition, uint32_t remainingTriangles)
+{
+    if (remainingTriangles == 0) {
+        return -1.0f;
+    }
+
+    float score = 0.0f;
+    if (cachePosition >= 0 && cachePosition < 3) {
+        // The last triangle's vertices score lower to avoid strips that turn back on themselves.
+        score = 0.75f;
+    } else if (cachePosition >= 3) {
+        float scale = 1.0f - static_cast<float>(cachePosition - 3) / (forsythCacheSize - 3);
+        score = std::pow(scale, 1.5f);
+    }
+
+    // Vertices with few triangles left are finished off first so they leave the working set.
+    return score + 2.0f * std::pow(static_cast<float>(remainingTriangles), -0.5f);
+}
+
+void optimizeVertexCache(uint32_t* indices, size_t indexCount, size_t vertexCount)
+{
+    size_t triangleCount = indexCount / 3;
+
+    std::vector<uint32_t> remaining(vertexCount, 0);
+    for (size_t i = 0; i < triangleCount * 3; i++) {
+        remaining[indices[i]]++;
+    }
+
+    // Triangles of vertex v live in adjacency[offsets[v], offsets[v] + remaining[v]), emitted
+    // triangles are swapped out of the live part of the range.
+    std::vector<uint32_t> offsets(vertexCount + 1, 0);
+    for (size_t v = 0; v < vertexCount; v++) {
+        offsets[v + 1] = offsets[v] + remaining[v];
+    }
+    std::vector<uint32_t> adjacency(triangleCount * 3);
+    std::vector<uint32_t> filled(vertexCount, 0);
+    for (uint32_t t = 0; t < triangleCount; t++) {
+        for (int k = 0; k < 3; k++) {
+            uint32_t v = indices[t * 3 + k];
+            adjacency[offsets[v] + filled[v]++] = t;
+        }
+    }
+
+    std::vector<int> cachePositions(vertexCount, -1);
+    std::vector<float> vertexScores(vertexCount);
+    for (size_t v = 0; v < vertexCount; v++) {
+        vertexScores[v] = vertexScore(-1, remaining[v]);
+    }
+
+    std::vector<float> triangleScores(triangleCount);
+    for (size_t t = 0; t < triangleCount; t++) {
+        triangleScores[t] = vertexScores[indices[t * 3]] + vertexScores[indices[t * 3 + 1]] +
+            vertexScores[indices[t * 3 + 2]];
+    }
+
+    std::vector<bool> emitted(triangleCount, false);
+    std::vector<uint32_t> output{};
+    output.reserve(triangleCount * 3);
+    std::vector<uint32_t> cache{};
+    std::vector<uint32_t> deadEnd{};
+    deadEnd.reserve(triangleCount * 3);
+    size_t scanStart = 0;
+    int64_t best = -1;
+
+    for (size_t n = 0; n < triangleCount; n++) {
+        // Nothing in the cache has triangles left. Continue from the most recently emitted vertex
+        // that still has some, else from the next triangle in input order. Scanning every
+        // remaining triangle here would make meshes of many disconnected pieces quadratic.
+        if (best < 0) {
+            while (!deadEnd.empty() && remaining[deadEnd.back()] == 0) {
+                deadEnd.pop_back();
+            }
+            if (!deadEnd.empty()) {
+                uint32_t v = deadEnd.back();
+                for (uint32_t j = 0; j < remaining[v]; j++) {
+                    uint32_t t = adjacency[offsets[v] + j];
+                    if (best < 0 || triangleScores[t] > triangleScores[best]) {
+                        best = t;
+                    }
+                }
+            } else {
+                while (emitted[scanStart]) {
+                    scanStart++;
+                }
+                best = scanStart;
+            }
+        }
+
+        uint32_t triangle = static_cast<uint32_t>(best);
+        emitted[triangle] = true;
+
+        std::vector<uint32_t> newCache{};
+        for (int k = 0; k < 3; k++) {
+            uint32_t v = indices[triangle * 3 + k];
+            output.push_back(v);
+            newCache.push_back(v);
+            deadEnd.push_back(v);
+
+            auto begin = adjacency.begin() + offsets[v];
+            auto end = begin + remaining[v];
+            std::iter_swap(std::find(begin, end, triangle), end - 1);
+            remaining[v]--;
+        }
+        for (uint32_t v : cache) {
+            if (std::find(newCache.begin(), newCache.begin() + 3, v) == newCache.begin() + 3) {
+                newCache.push_back(v);
+            }
+        }
+
+        // Rescore everything that moved in or fell out of the cache.
+        for (size_t i = 0; i < newCache.size(); i++) {
+            uint32_t v = newCache[i];
+            cachePositions[v] = i < forsythCacheSize ? static_cast<int>(i) : -1;
+            float score = vertexScore(cachePositions[v], remaining[v]);
+            float delta = score - vertexScores[v];
+            vertexScores[v] = score;
+            for (uint32_t j = 0; j < remaining[v]; j++) {
+                triangleScores[adjacency[offsets[v] + j]] += delta;
+            }
+        }
+        if (newCache.size() > forsythCacheSize) {
+            newCache.resize(forsythCacheSize);
+        }
+        cache = std::move(newCache);
+
+        best = -1;
+        for (uint32_t v : cache) {
+            for (uint32_t j = 0; j < remaining[v]; j++) {
+                uint32_t t = adjacency[offsets[v] + j];
+                if (best < 0 || triangleScores[t] > triangleScores[best]) {
+                    best = t;
+                }
+            }
+        }
+    }
+
+    std::copy(output.begin(), output.end(), indices);
+}
+
+static glm::vec3 vertexPosition(const MeshFileVertex& vertex)
+{
+    return glm::vec3{vertex.position[0], vertex.position[1], vertex.position[2]};
+}
+
+struct TriangleCluster {
+    size_t begin;
+    size_t end;
+    float sortKey;
+};
+
+void optimizeOverdraw(
+    uint32_t* indices, size_t indexCount, const std::vector<MeshFileVertex>& vertices)
+{
+    const uint32_t cacheSize = 16;
+    size_t triangleCount = indexCount / 3;
+
+    // A cluster starts wherever a triangle misses the cache on all three vertices, so reordering
+    // whole clusters costs nothing in cache efficiency.
+    std::vector<size_t> starts{};
+    std::vector<uint32_t> cache{};
+    for (size_t t = 0; t < triangleCount; t++) {
+        int misses = 0;
+        for (int k = 0; k < 3; k++) {
+            uint32_t v = indices[t * 3 + k];
+            if (std::find(cache.begin(), cache.end(), v) == cache.end()) {
+                misses++;
+                cache.push_back(v);
+                if (cache.size() > cacheSize) {
+                    cache.erase(cache.begin());
+                }
+            }
+        }
+        if (misses == 3 || t == 0) {
+            starts.push_back(t);
+        }
+    }
+
+    glm::vec3 meshCentroid{0.0f};
+    for (size_t i = 0; i < triangleCount * 3; i++) {
+        meshCentroid += vertexPosition(vertices[indices[i]]);
+    }
+    meshCentroid /= std::max<size_t>(triangleCount * 3, 1);
+
+    std::vector<TriangleCluster> clusters{};
+    for (size_t c = 0; c < starts.size(); c++) {
+        TriangleCluster cluster{};
+        cluster.begin = starts[c];
+        cluster.end = c + 1 < starts.size() ? starts[c + 1] : triangleCount;
+
+        glm::vec3 centroid{0.0f};
+        glm::vec3 normal{0.0f};
+        float area = 0.0f;
+        for (size_t t = cluster.begin; t < cluster.end; t++) {
+            glm::vec3 p0 = vertexPosition(vertices[indices[t * 3]]);
+            glm::vec3 p1 = vertexPosition(vertices[indices[t * 3 + 1]]);
+            glm::vec3 p2 = vertexPosition(vertices[indices[t * 3 + 2]]);
+            glm::vec3 cross = glm::cross(p1 - p0, p2 - p0);
+            float triangleArea = glm::length(cross);
+            centroid += (p0 + p1 + p2) / 3.0f * triangleArea;
+            normal += cross;
+            area += triangleArea;
+        }
+        if (area > 0.0f) {
+            centroid /= area;
+        }
+        if (glm::length(normal) > 0.0f) {
+            normal = glm::normalize(normal);
+        }
+
+        // Clusters facing away from the mesh centre are the most likely to occlude others.
+        cluster.sortKey = glm::dot(centroid - meshCentroid, normal);
+        clusters.push_back(cluster);
+    }
+
+    std::stable_sort(
+        clusters.begin(), clusters.end(), [](const TriangleCluster& a, const TriangleCluster& b) {
+            return a.sortKey > b.sortKey;
+        });
+
+    std::vector<uint32_t> output{};
+    output.reserve(triangleCount * 3);
+    for (auto& cluster : clusters) {
+        output.insert(output.end(), indices + cluster.begin * 3, indices + cluster.end * 3);
+    }
+    std::copy(output.begin(), output.end(), indices);
+}
+
+void optimizeVertexFetch(MeshData& mesh)
+{
+    const uint32_t unused = ~0u;
+    std::vector<uint32_t> remap(mesh.vertices.size(), unused);
+    std::vector<MeshFileVertex> vertices{};
+    vertices.reserve(mesh.vertices.size());
+
+    for (auto& index : mesh.indices) {
+        if (remap[index] == unused) {
+            remap[index] = static_cast<uint32_t>(vertices.size());
+            vertices.push_back(mesh.vertices[index]);
+        }
+        index = remap[index];
+    }
+    mesh.vertices = std::move(vertices);
+}
+
+void optimizeMesh(MeshData& mesh)
+{
+    deduplicateVertices(mesh);
+
+    for (auto& lod : mesh.lods) {
+        uint32_t* indices = mesh.indices.data() + lod.firstIndex;
+        optimizeVertexCache(indices, lod.indexCount, mesh.vertices.size());
+        optimizeOverdraw(indices, lod.indexCount, mesh.vertices);
+    }
+
+    optimizeVertexFetch(mesh);
+    mesh.bounds = meshBounds(mesh.vertices);
+}
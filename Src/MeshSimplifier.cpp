@@ -0,0 +1,299 @@
+#include "../Include/MeshSimplifier.h"
+#include <algorithm>
+#include <unordered_map>
+
+// Symmetric 4x4 matrix of summed plane equations; the error of a point is the sum of its squared
+// distances to the planes.
+struct Quadric {
+    double a00, a01, a02, a03, a11, a12, a13, a22, a23, a33;
+
+    Quadric& operator+=(const Quadric& rhs)
+    {
+        a00 += rhs.a00;
+        a01 += rhs.a01;
+        a02 += rhs.a02;
+        a03 += rhs.a03;
+        a11 += rhs.a11;
+        a12 += rhs.a12;
+        a13 += rhs.a13;
+        a22 += rhs.a22;
+        a23 += rhs.a23;
+        a33 += rhs.a33;
+        return *this;
+    }
+};
+
+static Quadric planeQuadric(glm::vec3 normal, float distance)
+{
+    double a = normal.x;
+    double b = normal.y;
+    double c = normal.z;
+    double d = distance;
+    return {a * a, a * b, a * c, a * d, b * b, b * c, b * d, c * c, c * d, d * d};
+}
+
+static double quadricError(const Quadric& q, glm::vec3 p)
+{
+    double x = p.x;
+    double y = p.y;
+    double z = p.z;
+    double error = q.a00 * x * x + 2 * q.a01 * x * y + 2 * q.a02 * x * z + 2 * q.a03 * x +
+        q.a11 * y * y + 2 * q.a12 * y * z + 2 * q.a13 * y + q.a22 * z * z + 2 * q.a23 * z + q.a33;
+    return std::max(error, 0.0);
+}
+
+static glm::vec3 vertexPosition(const MeshFileVertex& vertex)
+{
+    return glm::vec3{vertex.position[0], vertex.position[1], vertex.position[2]};
+}
+
+static uint64_t edgeKey(uint32_t a, uint32_t b)
+{
+    return (static_cast<uint64_t>(std::min(a, b)) << 32) | std::max(a, b);
+}
+
+struct PositionHash {
+    size_t operator()(const glm::vec3& position) const
+    {
+        uint32_t bits[3];
+        memcpy(bits, &position, sizeof(bits));
+        return (bits[0] * 73856093u) ^ (bits[1] * 19349663u) ^ (bits[2] * 83492791u);
+    }
+};
+
+// Border vertices and vertices split along UV or normal seams cannot move without opening cracks.
+static std::vector<bool> lockedVertices(
+    const std::vector<uint32_t>& indices, const std::vector<MeshFileVertex>& vertices)
+{
+    std::vector<bool> locked(vertices.size(), false);
+
+    std::unordered_map<uint64_t, uint32_t> edges{};
+    for (size_t t = 0; t < indices.size(); t += 3) {
+        for (int k = 0; k < 3; k++) {
+            edges[edgeKey(indices[t + k], indices[t + (k + 1) % 3])]++;
+        }
+    }
+    for (auto& edge : edges) {
+        if (edge.second == 1) {
+            locked[edge.first >> 32] = true;
+            locked[edge.first & 0xffffffff] = true;
+        }
+    }
+
+    std::unordered_map<glm::vec3, uint32_t, PositionHash> positions{};
+    for (uint32_t v = 0; v < vertices.size(); v++) {
+        auto result = positions.emplace(vertexPosition(vertices[v]), v);
+        if (!result.second) {
+            locked[v] = true;
+            locked[result.first->second] = true;
+        }
+    }
+
+    return locked;
+}
+
+struct Collapse {
+    uint32_t from;
+    uint32_t to;
+    double error;
+};
+
+// Triangles of vertex v are adjacency[offsets[v], offsets[v + 1]).
+struct TriangleAdjacency {
+    std::vector<uint32_t> offsets;
+    std::vector<uint32_t> triangles;
+};
+
+static TriangleAdjacency triangleAdjacency(const std::vector<uint32_t>& indices, size_t vertexCount)
+{
+    TriangleAdjacency adjacency{};
+    adjacency.offsets.assign(vertexCount + 1, 0);
+    for (uint32_t index : indices) {
+        adjacency.offsets[index + 1]++;
+    }
+    for (size_t v = 0; v < vertexCount; v++) {
+        adjacency.offsets[v + 1] += adjacency.offsets[v];
+    }
+
+    adjacency.triangles.resize(indices.size());
+    std::vector<uint32_t> filled(vertexCount, 0);
+    for (size_t i = 0; i < indices.size(); i++) {
+        uint32_t v = indices[i];
+        adjacency.triangles[adjacency.offsets[v] + filled[v]++] = static_cast<uint32_t>(i / 3);
+    }
+    return adjacency;
+}
+
+// Moving from onto to must not turn any remaining triangle around from over.
+static bool flipsTriangle(
+    const Collapse& collapse,
+    const std::vector<uint32_t>& indices,
+    const std::vector<MeshFileVertex>& vertices,
+    const TriangleAdjacency& adjacency)
+{
+    for (uint32_t i = adjacency.offsets[collapse.from]; i < adjacency.offsets[collapse.from + 1];
+         i++) {
+        const uint32_t* triangle = &indices[adjacency.triangles[i] * 3];
+        if (triangle[0] == collapse.to || triangle[1] == collapse.to || triangle[2] == collapse.to) {
+            continue;
+        }
+
+        glm::vec3 before[3];
+        glm::vec3 after[3];
+        for (int k = 0; k < 3; k++) {
+            before[k] = vertexPosition(vertices[triangle[k]]);
+            after[k] = triangle[k] == collapse.from ? vertexPosition(vertices[collapse.to]) : before[k];
+        }
+
+        glm::vec3 normalBefore = glm::cross(before[1] - before[0], before[2] - before[0]);
+        glm::vec3 normalAfter = glm::cross(after[1] - after[0], after[2] - after[0]);
+        if (glm::dot(normalBefore, normalAfter) <= 0.0f) {
+            return true;
+        }
+    }
+    return false;
+}
+
+std::vector<uint32_t> simplifyMesh(
+    const uint32_t* indices,
+    size_t indexCount,
+    const std::vector<MeshFileVertex>& vertices,
+    size_t targetIndexCount,
+    float& error)
+{
+    std::vector<uint32_t> result(indices, indices + indexCount / 3 * 3);
+    std::vector<bool> locked = lockedVertices(result, vertices);
+
+    std::vector<Quadric> quadrics(vertices.size(), Quadric{});
+    for (size_t t = 0; t < result.size(); t += 3) {
+        glm::vec3 p0 = vertexPosition(vertices[result[t]]);
+        glm::vec3 p1 = vertexPosition(vertices[result[t + 1]]);
+        glm::vec3 p2 = vertexPosition(vertices[result[t + 2]]);
+        glm::vec3 normal = glm::cross(p1 - p0, p2 - p0);
+        if (glm::length(normal) == 0.0f) {
+            continue;
+        }
+        normal = glm::normalize(normal);
+        Quadric quadric = planeQuadric(normal, -glm::dot(normal, p0));
+        for (int k = 0; k < 3; k++) {
+            quadrics[result[t + k]] += quadric;
+        }
+    }
+
+    double maxError = 0.0;
+
+    // Each pass collapses the cheapest edges whose neighbourhoods do not overlap, then rebuilds
+    // the index list.
+    while (result.size() > targetIndexCount) {
+        TriangleAdjacency adjacency = triangleAdjacency(result, vertices.size());
+
+        std::vector<Collapse> collapses{};
+        for (size_t t = 0; t < result.size(); t += 3) {
+            for (int k = 0; k < 3; k++) {
+                uint32_t a = result[t + k];
+                uint32_t b = result[t + (k + 1) % 3];
+                for (int direction = 0; direction < 2; direction++) {
+                    uint32_t from = direction == 0 ? a : b;
+                    uint32_t to = direction == 0 ? b : a;
+                    if (locked[from]) {
+                        continue;
+                    }
+                    Quadric quadric = quadrics[from];
+                    quadric += quadrics[to];
+                    collapses.push_back(
+                        {from, to, quadricError(quadric, vertexPosition(vertices[to]))});
+                }
+            }
+        }
+        std::sort(collapses.begin(), collapses.end(), [](const Collapse& a, const Collapse& b) {
+            return a.error < b.error;
+        });
+
+        std::vector<uint32_t> remap(vertices.size());
+        for (uint32_t v = 0; v < remap.size(); v++) {
+            remap[v] = v;
+        }
+        std::vector<bool> touched(vertices.size(), false);
+        size_t removeTarget = result.size() - targetIndexCount;
+        size_t removed = 0;
+
+        for (auto& collapse : collapses) {
+            if (removed >= removeTarget) {
+                break;
+            }
+            if (touched[collapse.from] || touched[collapse.to] ||
+                flipsTriangle(collapse, result, vertices, adjacency)) {
+                continue;
+            }
+
+            for (uint32_t i = adjacency.offsets[collapse.from];
+                 i < adjacency.offsets[collapse.from + 1];
+                 i++) {
+                const uint32_t* triangle = &result[adjacency.triangles[i] * 3];
+                bool shared = false;
+                for (int k = 0; k < 3; k++) {
+                    touched[triangle[k]] = true;
+                    shared = shared || triangle[k] == collapse.to;
+                }
+                removed += shared ? 3 : 0;
+            }
+
+            remap[collapse.from] = collapse.to;
+            quadrics[collapse.to] += quadrics[collapse.from];
+            maxError = std::max(maxError, collapse.error);
+        }
+
+        std::vector<uint32_t> collapsed{};
+        collapsed.reserve(result.size());
+        for (size_t t = 0; t < result.size(); t += 3) {
+            uint32_t a = remap[result[t]];
+            uint32_t b = remap[result[t + 1]];
+            uint32_t c = remap[result[t + 2]];
+            if (a != b && b != c && a != c) {
+                collapsed.insert(collapsed.end(), {a, b, c});
+            }
+        }
+
+        if (collapsed.size() == result.size()) {
+            break;
+        }
+        result = std::move(collapsed);
+    }
+
+    error = static_cast<float>(std::sqrt(maxError));
+    return result;
+}
+
+void generateLods(MeshData& mesh, uint32_t lodCount)
+{
+    MeshLod base = mesh.lods.empty() ? MeshLod{0, static_cast<uint32_t>(mesh.indices.size()), 0.0f}
+                                     : mesh.lods.front();
+
+    std::vector<uint32_t> indices(
+        mesh.indices.begin() + base.firstIndex,
+        mesh.indices.begin() + base.firstIndex + base.indexCount);
+    mesh.lods = {{0, base.indexCount, 0.0f}};
+
+    for (uint32_t level = 1; level < lodCount; level++) {
+        const MeshLod& previous = mesh.lods.back();
+        size_t target = previous.indexCount / 6 * 3;
+
+        float error = 0.0f;
+        std::vector<uint32_t> simplified = simplifyMesh(
+            indices.data() + previous.firstIndex, previous.indexCount, mesh.vertices, target, error);
+
+        // Further levels would barely differ once the mesh is mostly locked borders and seams.
+        if (simplified.empty() || simplified.size() > previous.indexCount * 3 / 4) {
+            break;
+        }
+
+        MeshLod lod{};
+        lod.firstIndex = static_cast<uint32_t>(indices.size());
+        lod.indexCount = static_cast<uint32_t>(simplified.size());
+        lod.error = previous.error + error;
+        indices.insert(indices.end(), simplified.begin(), simplified.end());
+        mesh.lods.push_back(lod);
+    }
+
+    mesh.indices = std::move(indices);
+}
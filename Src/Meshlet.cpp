@@ -0,0 +1,256 @@
+#include "../Include/Meshlet.h"
+#include <algorithm>
+#include <limits>
+#include <xmmintrin.h>
+
+static glm::vec3 vertexPosition(const MeshFileVertex& vertex)
+{
+    return glm::vec3{vertex.position[0], vertex.position[1], vertex.position[2]};
+}
+
+static Meshlet createMeshlet(
+    const uint32_t* indices,
+    size_t indexCount,
+    uint32_t firstIndex,
+    const std::vector<MeshFileVertex>& vertices)
+{
+    Meshlet meshlet{};
+    meshlet.firstIndex = firstIndex;
+    meshlet.indexCount = static_cast<uint32_t>(indexCount);
+
+    glm::vec3 min{vertexPosition(vertices[indices[0]])};
+    glm::vec3 max{min};
+    for (size_t i = 1; i < indexCount; i++) {
+        glm::vec3 position = vertexPosition(vertices[indices[i]]);
+        min = glm::min(min, position);
+        max = glm::max(max, position);
+    }
+    meshlet.center = (min + max) * 0.5f;
+    for (size_t i = 0; i < indexCount; i++) {
+        meshlet.radius = std::max(
+            meshlet.radius, glm::distance(meshlet.center, vertexPosition(vertices[indices[i]])));
+    }
+
+    std::vector<glm::vec3> normals{};
+    glm::vec3 normalSum{0.0f};
+    for (size_t t = 0; t < indexCount; t += 3) {
+        glm::vec3 p0 = vertexPosition(vertices[indices[t]]);
+        glm::vec3 p1 = vertexPosition(vertices[indices[t + 1]]);
+        glm::vec3 p2 = vertexPosition(vertices[indices[t + 2]]);
+        glm::vec3 normal = glm::cross(p1 - p0, p2 - p0);
+        if (glm::length(normal) > 0.0f) {
+            normals.push_back(glm::normalize(normal));
+            normalSum += normals.back();
+        }
+    }
+
+    // Disabled unless every triangle faces within 90 degrees of the average normal.
+    meshlet.coneApex = meshlet.center;
+    meshlet.coneAxis = glm::vec3{0.0f, 0.0f, 1.0f};
+    meshlet.coneCutoff = 2.0f;
+    if (normals.empty() || glm::length(normalSum) == 0.0f) {
+        return meshlet;
+    }
+
+    glm::vec3 axis = glm::normalize(normalSum);
+    float minDot = 1.0f;
+    for (auto& normal : normals) {
+        minDot = std::min(minDot, glm::dot(normal, axis));
+    }
+    if (minDot <= 0.0f) {
+        return meshlet;
+    }
+
+    // Moves the apex back along the axis until it lies behind every triangle plane.
+    float maxDistance = 0.0f;
+    size_t n = 0;
+    for (size_t t = 0; t < indexCount; t += 3) {
+        glm::vec3 p0 = vertexPosition(vertices[indices[t]]);
+        glm::vec3 p1 = vertexPosition(vertices[indices[t + 1]]);
+        glm::vec3 p2 = vertexPosition(vertices[indices[t + 2]]);
+        if (glm::length(glm::cross(p1 - p0, p2 - p0)) == 0.0f) {
+            continue;
+        }
+        const glm::vec3& normal = normals[n++];
+        maxDistance = std::max(
+            maxDistance, glm::dot(meshlet.center - p0, normal) / glm::dot(axis, normal));
+    }
+
+    meshlet.coneApex = meshlet.center - axis * maxDistance;
+    meshlet.coneAxis = axis;
+    meshlet.coneCutoff = std::sqrt(1.0f - minDot * minDot);
+    return meshlet;
+}
+
+std::vector<Meshlet> buildMeshlets(
+    const uint32_t* indices,
+    size_t indexCount,
+    uint32_t firstIndex,
+    const std::vector<MeshFileVertex>& vertices)
+{
+    std::vector<Meshlet> meshlets{};
+    std::vector<uint32_t> lastMeshlet(vertices.size(), std::numeric_limits<uint32_t>::max());
+    uint32_t meshletIndex = 0;
+    uint32_t vertexCount = 0;
+    size_t start = 0;
+
+    for (size_t t = 0; t + 2 < indexCount; t += 3) {
+        uint32_t newVertices = 0;
+        for (int k = 0; k < 3; k++) {
+            uint32_t v = indices[t + k];
+            bool repeated = (k > 0 && indices[t] == v) || (k > 1 && indices[t + 1] == v);
+            newVertices += lastMeshlet[v] != meshletIndex && !repeated ? 1 : 0;
+        }
+
+        if (vertexCount + newVertices > meshletMaxVertices ||
+            (t - start) / 3 == meshletMaxTriangles) {
+            meshlets.push_back(createMeshlet(
+                indices + start,
+                t - start,
+                firstIndex + static_cast<uint32_t>(start),
+                vertices));
+            meshletIndex++;
+            vertexCount = 0;
+            start = t;
+        }
+
+        for (int k = 0; k < 3; k++) {
+            uint32_t v = indices[t + k];
+            if (lastMeshlet[v] != meshletIndex) {
+                lastMeshlet[v] = meshletIndex;
+                vertexCount++;
+            }
+        }
+    }
+
+    size_t end = indexCount / 3 * 3;
+    if (end > start) {
+        meshlets.push_back(createMeshlet(
+            indices + start, end - start, firstIndex + static_cast<uint32_t>(start), vertices));
+    }
+
+    return meshlets;
+}
+
+MeshletBounds meshletBounds(const std::vector<Meshlet>& meshlets)
+{
+    size_t paddedSize = meshlets.size() + 3;
+
+    MeshletBounds bounds{};
+    bounds.centerX.assign(paddedSize, 0.0f);
+    bounds.centerY.assign(paddedSize, 0.0f);
+    bounds.centerZ.assign(paddedSize, 0.0f);
+    bounds.radius.assign(paddedSize, 0.0f);
+    bounds.apexX.assign(paddedSize, 0.0f);
+    bounds.apexY.assign(paddedSize, 0.0f);
+    bounds.apexZ.assign(paddedSize, 0.0f);
+    bounds.axisX.assign(paddedSize, 0.0f);
+    bounds.axisY.assign(paddedSize, 0.0f);
+    bounds.axisZ.assign(paddedSize, 0.0f);
+    bounds.cutoff.assign(paddedSize, 2.0f);
+
+    for (size_t i = 0; i < meshlets.size(); i++) {
+        const Meshlet& meshlet = meshlets[i];
+        bounds.centerX[i] = meshlet.center.x;
+        bounds.centerY[i] = meshlet.center.y;
+        bounds.centerZ[i] = meshlet.center.z;
+        bounds.radius[i] = meshlet.radius;
+        bounds.apexX[i] = meshlet.coneApex.x;
+        bounds.apexY[i] = meshlet.coneApex.y;
+        bounds.apexZ[i] = meshlet.coneApex.z;
+        bounds.axisX[i] = meshlet.coneAxis.x;
+        bounds.axisY[i] = meshlet.coneAxis.y;
+        bounds.axisZ[i] = meshlet.coneAxis.z;
+        bounds.cutoff[i] = meshlet.coneCutoff;
+    }
+
+    return bounds;
+}
+
+std::array<glm::vec4, 6> frustumPlanes(const glm::mat4& matrix)
+{
+    glm::vec4 x = glm::row(matrix, 0);
+    glm::vec4 y = glm::row(matrix, 1);
+    glm::vec4 z = glm::row(matrix, 2);
+    glm::vec4 w = glm::row(matrix, 3);
+
+    std::array<glm::vec4, 6> planes{w + x, w - x, w + y, w - y, z, w - z};
+    for (auto& plane : planes) {
+        plane /= glm::length(glm::vec3{plane});
+    }
+    return planes;
+}
+
+uint32_t cullMeshlets(
+    const std::vector<Meshlet>& meshlets,
+    const MeshletBounds& bounds,
+    size_t first,
+    size_t count,
+    const std::array<glm::vec4, 6>& planes,
+    const glm::vec3& viewPosition,
+    bool coneCulling,
+    vk::DrawIndexedIndirectCommand* commands)
+{
+    uint32_t drawCount = 0;
+    __m128 zero = _mm_setzero_ps();
+    __m128 viewX = _mm_set1_ps(viewPosition.x);
+    __m128 viewY = _mm_set1_ps(viewPosition.y);
+    __m128 viewZ = _mm_set1_ps(viewPosition.z);
+
+    for (size_t i = 0; i < count; i += 4) {
+        size_t m = first + i;
+        __m128 centerX = _mm_loadu_ps(&bounds.centerX[m]);
+        __m128 centerY = _mm_loadu_ps(&bounds.centerY[m]);
+        __m128 centerZ = _mm_loadu_ps(&bounds.centerZ[m]);
+        __m128 negativeRadius = _mm_sub_ps(zero, _mm_loadu_ps(&bounds.radius[m]));
+
+        __m128 visible = _mm_cmpeq_ps(zero, zero);
+        for (auto& plane : planes) {
+            __m128 distance = _mm_add_ps(
+                _mm_add_ps(
+                    _mm_mul_ps(centerX, _mm_set1_ps(plane.x)),
+                    _mm_mul_ps(centerY, _mm_set1_ps(plane.y))),
+                _mm_add_ps(_mm_mul_ps(centerZ, _mm_set1_ps(plane.z)), _mm_set1_ps(plane.w)));
+            visible = _mm_and_ps(visible, _mm_cmpge_ps(distance, negativeRadius));
+        }
+
+        // dot(apex - view, axis) > cutoff * length(apex - view) avoids normalizing.
+        if (coneCulling) {
+            __m128 dx = _mm_sub_ps(_mm_loadu_ps(&bounds.apexX[m]), viewX);
+            __m128 dy = _mm_sub_ps(_mm_loadu_ps(&bounds.apexY[m]), viewY);
+            __m128 dz = _mm_sub_ps(_mm_loadu_ps(&bounds.apexZ[m]), viewZ);
+            __m128 length = _mm_sqrt_ps(_mm_add_ps(
+                _mm_add_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dy, dy)), _mm_mul_ps(dz, dz)));
+            __m128 dot = _mm_add_ps(
+                _mm_add_ps(
+                    _mm_mul_ps(dx, _mm_loadu_ps(&bounds.axisX[m])),
+                    _mm_mul_ps(dy, _mm_loadu_ps(&bounds.axisY[m]))),
+                _mm_mul_ps(dz, _mm_loadu_ps(&bounds.axisZ[m])));
+            __m128 backFacing =
+                _mm_cmpgt_ps(dot, _mm_mul_ps(_mm_loadu_ps(&bounds.cutoff[m]), length));
+            visible = _mm_andnot_ps(backFacing, visible);
+        }
+
+        int mask = _mm_movemask_ps(visible);
+        size_t lanes = std::min<size_t>(4, count - i);
+        for (size_t lane = 0; lane < lanes; lane++) {
+            if (!(mask & (1 << lane))) {
+                continue;
+            }
+
+            // Neighbouring visible meshlets are contiguous in the index buffer and share a draw.
+            const Meshlet& meshlet = meshlets[m + lane];
+            if (drawCount > 0) {
+                vk::DrawIndexedIndirectCommand& previous = commands[drawCount - 1];
+                if (previous.firstIndex + previous.indexCount == meshlet.firstIndex) {
+                    previous.indexCount += meshlet.indexCount;
+                    continue;
+                }
+            }
+            commands[drawCount++] = vk::DrawIndexedIndirectCommand{
+                meshlet.indexCount, 1, meshlet.firstIndex, 0, 0};
+        }
+    }
+
+    return drawCount;
+}
@@ -5,156 +5,49 @@
 #include "../Include/Device.h"
 #include "../Include/SwapChain.h"
 #include "../Include/TextureManager.h"
+#include <algorithm>
+#include <cstddef>
 #include <fstream>
 #include <iostream>
-#include <spirv_cross.hpp>
 #include <sstream>
 #include <vulkan/vulkan.hpp>
 
 Pipeline::Pipeline(Pipeline&& rhs)
     : mDevice{rhs.mDevice},
+      mTextureManager{rhs.mTextureManager},
       mFramebufferSet{std::move(rhs.mFramebufferSet)},
+      mReflection{std::move(rhs.mReflection)},
       mTexture{rhs.mTexture},
+      mTextureRevision{rhs.mTextureRevision},
+      mMaterialConstants{rhs.mMaterialConstants},
+      mCullMode{rhs.mCullMode},
       mDescriptorSet{std::move(rhs.mDescriptorSet)},
       mPipelineLayout{rhs.mPipelineLayout},
-      mPipeline{rhs.mPipeline}
+      mPipelineKey{std::move(rhs.mPipelineKey)},
+      mPipeline{std::move(rhs.mPipeline)}
 {
     rhs.mPipelineLayout = nullptr;
-    rhs.mPipeline = nullptr;
-    rhs.mTexture = nullptr;
+    rhs.mTexture = {};
 }
 
-vk::PipelineLayout createPipelineLayout(
-    Device& device,
-    vk::DescriptorSetLayout descriptorSetLayout,
-    vk::DescriptorSetLayout descriptorSetLayout2,
-    const nlohmann::json& json)
-{
-    vk::PushConstantRange pushConstantRange{};
-    pushConstantRange.offset = 0;
-    pushConstantRange.size = sizeof(float) * 16;
-    pushConstantRange.stageFlags = vk::ShaderStageFlagBits::eVertex;
-
-    vk::PipelineLayoutCreateInfo pipelineLayoutInfo{};
-
-    std::vector<vk::DescriptorSetLayout> layouts{};
-    if (descriptorSetLayout) {
-        layouts.push_back(descriptorSetLayout);
-    }
-    if (descriptorSetLayout2) {
-        layouts.push_back(descriptorSetLayout2);
-    }
-
-    pipelineLayoutInfo.setLayoutCount = static_cast<uint32_t>(layouts.size());
-    pipelineLayoutInfo.pSetLayouts = layouts.data();
-
-    pipelineLayoutInfo.pushConstantRangeCount = 1;
-    pipelineLayoutInfo.pPushConstantRanges = &pushConstantRange;
-
-    vk::PipelineLayout pipelineLayout =
-        static_cast<vk::Device>(device).createPipelineLayout(pipelineLayoutInfo);
-    return pipelineLayout;
-}
-
-vk::ShaderModule createShaderFromFile(vk::Device device, std::string filename)
-{
-    auto code = readFile(filename);
-    vk::ShaderModuleCreateInfo createInfo{};
-    createInfo.codeSize = code.size();
-    createInfo.pCode = reinterpret_cast<const uint32_t*>(code.data());
-    vk::ShaderModule shaderModule = device.createShaderModule(createInfo, nullptr);
-    return shaderModule;
-}
-
-vk::ShaderModule createShaderFromFileByKey(
-    vk::Device device, const nlohmann::json& json, std::string keyname)
-{
-    if (json.contains(keyname)) {
-        return createShaderFromFile(device, json[keyname]);
-    } else {
-        return nullptr;
-    }
-}
-
-bool hasKey(const nlohmann::json& json, const std::string& key)
-{
-    if (json.find(key) != json.end()) {
-        return true;
-    } else {
-        return false;
-    }
-}
-
-vk::PipelineRasterizationStateCreateInfo rasterizationStateCreateInfo(const nlohmann::json& json)
+vk::PipelineRasterizationStateCreateInfo rasterizationStateCreateInfo(
+    const PipelineDescription& description)
 {
     vk::PipelineRasterizationStateCreateInfo info{};
-
-    if (hasKey(json, "polygonMode")) {
-        auto mode = json["polygonMode"];
-        if (mode == "Fill") {
-            info.polygonMode = vk::PolygonMode::eFill;
-        } else if (mode == "Line") {
-            info.polygonMode = vk::PolygonMode::eLine;
-        } else if (mode == "Point") {
-            info.polygonMode = vk::PolygonMode::ePoint;
-        }
-    }
+    info.polygonMode = description.polygonMode;
     info.lineWidth = 1.0f;
-
-    if (hasKey(json, "cullMode")) {
-        auto mode = json["cullMode"];
-        if (mode == "None") {
-            info.cullMode = vk::CullModeFlagBits::eNone;
-        } else if (mode == "Front") {
-            info.cullMode = vk::CullModeFlagBits::eFront;
-        } else if (mode == "Back") {
-            info.cullMode = vk::CullModeFlagBits::eBack;
-        } else if (mode == "FrontAndBack") {
-            info.cullMode = vk::CullModeFlagBits::eFrontAndBack;
-        }
-    }
+    info.cullMode = description.cullMode;
     info.frontFace = vk::FrontFace::eCounterClockwise;
-
     return info;
 }
 
-vk::CompareOp compareOp(const std::string& op)
-{
-    if (op == "Never") {
-        return vk::CompareOp::eNever;
-    } else if (op == "Less") {
-        return vk::CompareOp::eLess;
-    } else if (op == "Equal") {
-        return vk::CompareOp::eEqual;
-    } else if (op == "LessOrEqual") {
-        return vk::CompareOp::eLessOrEqual;
-    } else if (op == "Greater") {
-        return vk::CompareOp::eGreater;
-    } else if (op == "NotEqual") {
-        return vk::CompareOp::eNotEqual;
-    } else if (op == "GreaterOrEqual") {
-        return vk::CompareOp::eGreaterOrEqual;
-    } else if (op == "Always") {
-        return vk::CompareOp::eAlways;
-    } else {
-        throw std::runtime_error{"Invalid comparison operator.\n"};
-    }
-}
-
-vk::PipelineDepthStencilStateCreateInfo depthStencilStateCreateInfo(const nlohmann::json& json)
+vk::PipelineDepthStencilStateCreateInfo depthStencilStateCreateInfo(
+    const PipelineDescription& description)
 {
     vk::PipelineDepthStencilStateCreateInfo depthStencil{};
-
-    if (hasKey(json, "depthTestEnable")) {
-        depthStencil.depthTestEnable = json["depthTestEnable"];
-    }
-    if (hasKey(json, "depthWriteEnable")) {
-        depthStencil.depthWriteEnable = json["depthWriteEnable"];
-    }
-    if (hasKey(json, "depthCompareOp")) {
-        depthStencil.depthCompareOp = compareOp(json["depthCompareOp"]);
-    }
-
+    depthStencil.depthTestEnable = description.depthTestEnable;
+    depthStencil.depthWriteEnable = description.depthWriteEnable;
+    depthStencil.depthCompareOp = description.depthCompareOp;
     return depthStencil;
 }
 
@@ -163,7 +56,7 @@ struct ColorBlendStateCreateInfo {
     vk::PipelineColorBlendStateCreateInfo info;
 };
 
-ColorBlendStateCreateInfo colorBlendStateCreateInfo(const nlohmann::json& json)
+ColorBlendStateCreateInfo colorBlendStateCreateInfo(const PipelineDescription& description)
 {
     ColorBlendStateCreateInfo info{};
     info.attachments.resize(1);
@@ -181,7 +74,8 @@ ColorBlendStateCreateInfo colorBlendStateCreateInfo(const nlohmann::json& json)
     return info;
 }
 
-vk::PipelineMultisampleStateCreateInfo multisampleStateCreateInfo(const nlohmann::json& json)
+vk::PipelineMultisampleStateCreateInfo multisampleStateCreateInfo(
+    const PipelineDescription& description)
 {
     vk::PipelineMultisampleStateCreateInfo info{};
     info.sampleShadingEnable = false;
@@ -193,37 +87,48 @@ vk::PipelineMultisampleStateCreateInfo multisampleStateCreateInfo(const nlohmann
     return info;
 }
 
-struct ViewportStateCreateInfo {
-    std::vector<vk::Viewport> viewports;
-    std::vector<vk::Rect2D> scissors;
-    vk::PipelineViewportStateCreateInfo info;
-};
-
-ViewportStateCreateInfo viewportStateCreateInfo(
-    const nlohmann::json& json, vk::Extent2D swapChainExtent)
+// Viewport and scissor are dynamic state so pipelines do not depend on the render target size.
+vk::PipelineViewportStateCreateInfo viewportStateCreateInfo()
 {
-    ViewportStateCreateInfo info{};
-    info.viewports.resize(1);
-    info.scissors.resize(1);
-
-    info.viewports[0].x = 0.0f;
-    info.viewports[0].y = 0.0f;
-    info.viewports[0].width = static_cast<float>(swapChainExtent.width);
-    info.viewports[0].height = static_cast<float>(swapChainExtent.height);
-    info.viewports[0].minDepth = 0.0f;
-    info.viewports[0].maxDepth = 1.0f;
-
-    info.scissors[0].offset = vk::Offset2D(0, 0);
-    info.scissors[0].extent = swapChainExtent;
+    vk::PipelineViewportStateCreateInfo info{};
+    info.viewportCount = 1;
+    info.pViewports = nullptr;
+    info.scissorCount = 1;
+    info.pScissors = nullptr;
+    return info;
+}
 
-    info.info.viewportCount = 1;
-    info.info.pViewports = &info.viewports[0];
-    info.info.scissorCount = 1;
-    info.info.pScissors = &info.scissors[0];
+struct DynamicStateCreateInfo {
+    std::vector<vk::DynamicState> states;
+    vk::PipelineDynamicStateCreateInfo info;
+};
 
+DynamicStateCreateInfo dynamicStateCreateInfo()
+{
+    DynamicStateCreateInfo info{};
+    info.states = {vk::DynamicState::eViewport, vk::DynamicState::eScissor};
+    info.info.dynamicStateCount = static_cast<uint32_t>(info.states.size());
+    info.info.pDynamicStates = info.states.data();
     return info;
 }
 
+void setViewportAndScissor(vk::CommandBuffer commandBuffer, vk::Extent2D extent)
+{
+    vk::Viewport viewport{};
+    viewport.x = 0.0f;
+    viewport.y = 0.0f;
+    viewport.width = static_cast<float>(extent.width);
+    viewport.height = static_cast<float>(extent.height);
+    viewport.minDepth = 0.0f;
+    viewport.maxDepth = 1.0f;
+    commandBuffer.setViewport(0, viewport);
+
+    vk::Rect2D scissor{};
+    scissor.offset = vk::Offset2D(0, 0);
+    scissor.extent = extent;
+    commandBuffer.setScissor(0, scissor);
+}
+
 vk::PipelineVertexInputStateCreateInfo vertexInputStateCreateInfo(
     const vk::VertexInputBindingDescription& bindingDescription,
     const std::vector<vk::VertexInputAttributeDescription>& attributeDescriptions)
@@ -244,129 +149,274 @@ vk::PipelineInputAssemblyStateCreateInfo inputAssemblyStateCreateInfo()
     return info;
 }
 
-std::vector<uint32_t> readSpirvFile(const std::string& filename)
+struct ShaderStagesCreateInfo {
+    std::vector<vk::PipelineShaderStageCreateInfo> stages;
+    std::vector<std::vector<vk::SpecializationMapEntry>> mapEntries;
+    std::vector<std::vector<uint32_t>> data;
+    std::vector<vk::SpecializationInfo> specializationInfos;
+};
+
+static uint32_t specializationConstantValue(double value, SpecializationConstantType type)
 {
-    std::ifstream file(filename, std::ios::ate | std::ios::binary);
-    if (!file.is_open()) {
-        throw std::runtime_error("Failed to open file!");
+    uint32_t data = 0;
+    if (type == SpecializationConstantType::Bool) {
+        data = value != 0.0;
+    } else if (type == SpecializationConstantType::Int) {
+        int32_t v = static_cast<int32_t>(value);
+        memcpy(&data, &v, sizeof(data));
+    } else if (type == SpecializationConstantType::UInt) {
+        data = static_cast<uint32_t>(value);
+    } else if (type == SpecializationConstantType::Float) {
+        float v = static_cast<float>(value);
+        memcpy(&data, &v, sizeof(data));
     }
+    return data;
+}
 
-    size_t fileSize = (size_t)file.tellg();
-    std::vector<char> buffer(fileSize);
-    file.seekg(0);
-    file.read(buffer.data(), fileSize);
-    file.close();
-
-    std::vector<uint32_t> buffer32(buffer.size() / sizeof(uint32_t));
-    memcpy(buffer32.data(), buffer.data(), buffer.size());
-    return buffer32;
+static const SpecializationConstantDescription* findSpecializationConstant(
+    const std::vector<SpecializationConstantDescription>& constants, const std::string& key)
+{
+    for (auto& constant : constants) {
+        if (constant.key == key) {
+            return &constant;
+        }
+    }
+    return nullptr;
 }
 
-std::vector<vk::PipelineShaderStageCreateInfo> createShaderStages(
-    Device& device, const nlohmann::json& json)
+// Entries of "specializationConstants" are matched by constant name, or by constant_id when the
+// key is a number, against the constants each stage actually declares.
+static void specializeShaderStage(
+    const std::vector<SpecializationConstantDescription>& constants,
+    const ShaderReflection& reflection,
+    std::vector<vk::SpecializationMapEntry>& mapEntries,
+    std::vector<uint32_t>& data)
 {
-    std::vector<vk::PipelineShaderStageCreateInfo> shaderStages{};
+    for (auto& constant : reflection.specializationConstants) {
+        auto value = findSpecializationConstant(constants, constant.name);
+        if (!value) {
+            value = findSpecializationConstant(constants, std::to_string(constant.constantId));
+        }
+        if (!value) {
+            continue;
+        }
 
-    if (hasKey(json, "vertexShader")) {
-        vk::PipelineShaderStageCreateInfo vertShaderStageInfo;
-        vertShaderStageInfo.stage = vk::ShaderStageFlagBits::eVertex;
-        vertShaderStageInfo.module = createShaderFromFile(device, json["vertexShader"]);
-        vertShaderStageInfo.pName = "main";
-        shaderStages.push_back(vertShaderStageInfo);
+        vk::SpecializationMapEntry mapEntry{};
+        mapEntry.constantID = constant.constantId;
+        mapEntry.offset = static_cast<uint32_t>(data.size() * sizeof(uint32_t));
+        mapEntry.size = sizeof(uint32_t);
+        mapEntries.push_back(mapEntry);
+        data.push_back(specializationConstantValue(value->value, constant.type));
     }
+}
 
-    if (hasKey(json, "fragmentShader")) {
-        vk::PipelineShaderStageCreateInfo fragShaderStageInfo;
-        fragShaderStageInfo.stage = vk::ShaderStageFlagBits::eFragment;
-        fragShaderStageInfo.module = createShaderFromFile(device, json["fragmentShader"]);
-        fragShaderStageInfo.pName = "main";
-        shaderStages.push_back(fragShaderStageInfo);
+static std::vector<std::pair<std::string, vk::ShaderStageFlagBits>> shaderFilenames(
+    const PipelineDescription& description)
+{
+    std::vector<std::pair<std::string, vk::ShaderStageFlagBits>> filenames{};
+    if (!description.vertexShader.empty()) {
+        filenames.push_back({description.vertexShader, vk::ShaderStageFlagBits::eVertex});
+    }
+    if (!description.fragmentShader.empty()) {
+        filenames.push_back({description.fragmentShader, vk::ShaderStageFlagBits::eFragment});
     }
+    return filenames;
+}
 
-    if (!hasKey(json, "fragmentShader")) {
-        return shaderStages;
+ShaderStagesCreateInfo createShaderStages(Device& device, const PipelineDescription& description)
+{
+    ShaderStagesCreateInfo info{};
+
+    for (auto& filename : shaderFilenames(description)) {
+        auto& shader = device.shaderLibrary().shader(filename.first);
+
+        vk::PipelineShaderStageCreateInfo stageInfo;
+        stageInfo.stage = filename.second;
+        stageInfo.module = shader.module;
+        stageInfo.pName = "main";
+        info.stages.push_back(stageInfo);
+
+        info.mapEntries.emplace_back();
+        info.data.emplace_back();
+        specializeShaderStage(
+            description.specializationConstants,
+            shader.reflection,
+            info.mapEntries.back(),
+            info.data.back());
     }
 
-    std::cout << "Fragment shader resources:\n";
-    auto spirvBinary = readSpirvFile(json["fragmentShader"]);
-    spirv_cross::Compiler compiler(std::move(spirvBinary));
+    // Pointers are taken only after all vectors have reached their final size.
+    info.specializationInfos.resize(info.stages.size());
+    for (size_t i = 0; i < info.stages.size(); i++) {
+        if (info.mapEntries[i].empty()) {
+            continue;
+        }
+        info.specializationInfos[i].mapEntryCount = static_cast<uint32_t>(info.mapEntries[i].size());
+        info.specializationInfos[i].pMapEntries = info.mapEntries[i].data();
+        info.specializationInfos[i].dataSize = info.data[i].size() * sizeof(uint32_t);
+        info.specializationInfos[i].pData = info.data[i].data();
+        info.stages[i].pSpecializationInfo = &info.specializationInfos[i];
+    }
 
-    spirv_cross::ShaderResources resources = compiler.get_shader_resources();
+    return info;
+}
 
-    //for (auto& image : resources.sampled_images) {
-    //    std::cout << "Sampled image name: " << image.name << "\n";
-    //    std::cout << "Sampled image id: " << image.id << "\n";
-    //    std::cout << "Sampled image type id: " << image.type_id << "\n";
-    //    std::cout << "Sampled image base type id: " << image.base_type_id << "\n";
+static void mergeDescriptorBinding(
+    std::vector<vk::DescriptorSetLayoutBinding>& bindings, const vk::DescriptorSetLayoutBinding& binding)
+{
+    for (auto& existing : bindings) {
+        if (existing.binding == binding.binding) {
+            if (existing.descriptorType != binding.descriptorType ||
+                existing.descriptorCount != binding.descriptorCount) {
+                throw std::runtime_error("Shader stages disagree on descriptor binding!");
+            }
+            existing.stageFlags |= binding.stageFlags;
+            return;
+        }
+    }
+    bindings.push_back(binding);
+}
 
-    //    std::cout << "Sampler image set: "
-    //              << compiler.get_decoration(image.id, spv::DecorationDescriptorSet) << "\n";
+// Stages declaring the same block share one range; differing blocks keep their own range, and
+// Pipeline::pushConstants names the right stages for every byte it pushes.
+static void mergePushConstantRange(
+    std::vector<vk::PushConstantRange>& ranges, const vk::PushConstantRange& range)
+{
+    for (auto& existing : ranges) {
+        if (existing.offset == range.offset && existing.size == range.size) {
+            existing.stageFlags |= range.stageFlags;
+            return;
+        }
+    }
+    ranges.push_back(range);
+}
 
-    //    std::cout << "Sampler image binding: "
-    //              << compiler.get_decoration(image.id, spv::DecorationBinding) << "\n\n";
-    //}
+static bool hasPushConstantMember(
+    const ShaderReflection& reflection, const std::string& name, uint32_t offset, size_t size)
+{
+    for (auto& member : reflection.pushConstantMembers) {
+        if (member.name == name && member.offset == offset && member.size == size) {
+            return true;
+        }
+    }
+    return false;
+}
 
-    for (auto& buffer : resources.uniform_buffers) {
-        std::cout << "Uniform buffer name: " << buffer.name << "\n";
+static PipelineReflection reflectPipeline(Device& device, const PipelineDescription& description)
+{
+    PipelineReflection reflection{};
+    reflection.materialConstants = false;
+    reflection.hasVertexShader = false;
 
-        auto& type = compiler.get_type(buffer.base_type_id);
-        auto count = type.member_types.size();
+    for (auto& filename : shaderFilenames(description)) {
+        auto& shader = device.shaderLibrary().shader(filename.first);
 
-        for (auto i = 0; i < count; i++) {
-            const auto& name = compiler.get_member_name(type.self, i);
-            std::cout << "Uniform member name: " << name << "\n";
+        for (auto& binding : shader.reflection.descriptorBindings) {
+            mergeDescriptorBinding(reflection.descriptorSets[binding.set], binding.binding);
+        }
+        for (auto& range : shader.reflection.pushConstantRanges) {
+            mergePushConstantRange(reflection.pushConstantRanges, range);
+        }
+        if (hasPushConstantMember(
+                shader.reflection,
+                "uvTransform",
+                offsetof(MaterialConstants, uvTransform),
+                sizeof(MaterialConstants::uvTransform)) &&
+            hasPushConstantMember(
+                shader.reflection,
+                "layer",
+                offsetof(MaterialConstants, layer),
+                sizeof(MaterialConstants::layer))) {
+            reflection.materialConstants = true;
+        }
+        if (shader.reflection.stage == vk::ShaderStageFlagBits::eVertex) {
+            reflection.hasVertexShader = true;
+            reflection.vertexInputLocations = shader.reflection.inputLocations;
+        }
+    }
 
-            auto memberType = compiler.get_type(type.member_types[i]);
+    return reflection;
+}
 
-            std::cout << "Uniform member type: " << memberType.basetype
-                      << " is float: " << (memberType.basetype == spirv_cross::SPIRType::Float)
-                      << "\n";
+// Drops attributes the vertex shader does not consume and fails early on inputs the vertex
+// layout does not provide.
+static std::vector<vk::VertexInputAttributeDescription> vertexInputAttributes(
+    const std::vector<vk::VertexInputAttributeDescription>& attributeDescriptions,
+    const PipelineReflection& reflection)
+{
+    if (!reflection.hasVertexShader) {
+        return attributeDescriptions;
+    }
 
-            auto offset = compiler.type_struct_member_offset(type, i);
-            std::cout << "Uniform member offset: " << offset << "\n";
+    std::vector<vk::VertexInputAttributeDescription> attributes{};
+    for (uint32_t location : reflection.vertexInputLocations) {
+        auto it = std::find_if(
+            attributeDescriptions.begin(),
+            attributeDescriptions.end(),
+            [location](const vk::VertexInputAttributeDescription& attribute) {
+                return attribute.location == location;
+            });
+        if (it == attributeDescriptions.end()) {
+            throw std::runtime_error("Vertex shader input not provided by vertex layout!");
+        }
+        attributes.push_back(*it);
+    }
+    return attributes;
+}
 
-            auto memberSize = compiler.get_declared_struct_member_size(type, i);
-            std::cout << "Uniform member size: " << memberSize << "\n";
+static uint32_t materialSetIndex(vk::DescriptorSetLayout descriptorSetLayout)
+{
+    return descriptorSetLayout ? 1 : 0;
+}
 
-            if (!memberType.array.empty()) {
-                auto arrayStride = compiler.type_struct_member_array_stride(type, i);
-                std::cout << "Uniform member is array with stride: " << arrayStride << "\n";
-            } else {
-                std::cout << "Uniform member is not array\n";
-            }
+static std::vector<vk::DescriptorSetLayoutBinding> materialBindings(
+    const PipelineReflection& reflection, vk::DescriptorSetLayout descriptorSetLayout)
+{
+    uint32_t materialSet = materialSetIndex(descriptorSetLayout);
 
-            //if (memberType.columns > 1) {
-            //    auto matrixStride = compiler.type_struct_member_matrix_stride(type, i);
-            //}
-            std::cout << "\n";
+    for (auto& set : reflection.descriptorSets) {
+        if (set.first > materialSet) {
+            throw std::runtime_error("Shader uses a descriptor set the pipeline does not provide!");
         }
     }
 
-    //for (auto& input : resources.stage_inputs) {
-    //    std::cout << "Input name: " << input.name << "\n";
-    //}
+    auto it = reflection.descriptorSets.find(materialSet);
+    if (it == reflection.descriptorSets.end()) {
+        return {};
+    }
+    return it->second;
+}
 
-    //for (auto& output : resources.stage_outputs) {
-    //    std::cout << "Outpu name: " << output.name << "\n";
-    //}
+vk::PipelineLayout createPipelineLayout(
+    DescriptorManager& descriptorManager,
+    vk::DescriptorSetLayout descriptorSetLayout,
+    vk::DescriptorSetLayout descriptorSetLayout2,
+    const PipelineReflection& reflection)
+{
+    std::vector<vk::DescriptorSetLayout> layouts{};
+    if (descriptorSetLayout) {
+        layouts.push_back(descriptorSetLayout);
+    }
+    if (descriptorSetLayout2) {
+        layouts.push_back(descriptorSetLayout2);
+    }
 
-    return shaderStages;
+    return descriptorManager.pipelineLayout(layouts, reflection.pushConstantRanges);
 }
 
 vk::Pipeline createPipeline(
     Device& device,
-    FramebufferSet& framebufferSet,
+    vk::RenderPass renderPass,
     vk::VertexInputBindingDescription bindingDescription,
     std::vector<vk::VertexInputAttributeDescription> attributeDescriptions,
-    vk::Extent2D swapChainExtent,
     vk::PipelineLayout pipelineLayout,
-    const nlohmann::json& json)
+    const PipelineDescription& description)
 {
     vk::GraphicsPipelineCreateInfo pipelineInfo{};
 
-    auto shaderStages = createShaderStages(device, json);
-    pipelineInfo.stageCount = static_cast<uint32_t>(shaderStages.size());
-    pipelineInfo.pStages = shaderStages.data();
+    auto shaderStages = createShaderStages(device, description);
+    pipelineInfo.stageCount = static_cast<uint32_t>(shaderStages.stages.size());
+    pipelineInfo.pStages = shaderStages.stages.data();
 
     auto inputAssemblyState = inputAssemblyStateCreateInfo();
     pipelineInfo.pInputAssemblyState = &inputAssemblyState;
@@ -374,63 +424,153 @@ vk::Pipeline createPipeline(
     auto vertexInputState = vertexInputStateCreateInfo(bindingDescription, attributeDescriptions);
     pipelineInfo.pVertexInputState = &vertexInputState;
 
-    auto viewportState = viewportStateCreateInfo(json, swapChainExtent);
-    pipelineInfo.pViewportState = &viewportState.info;
+    auto viewportState = viewportStateCreateInfo();
+    pipelineInfo.pViewportState = &viewportState;
 
-    auto rasterizationState = rasterizationStateCreateInfo(json);
+    auto rasterizationState = rasterizationStateCreateInfo(description);
     pipelineInfo.pRasterizationState = &rasterizationState;
 
-    auto multisampleState = multisampleStateCreateInfo(json);
+    auto multisampleState = multisampleStateCreateInfo(description);
     pipelineInfo.pMultisampleState = &multisampleState;
 
-    auto depthStencil = depthStencilStateCreateInfo(json);
+    auto depthStencil = depthStencilStateCreateInfo(description);
     pipelineInfo.pDepthStencilState = &depthStencil;
 
-    auto colorBlendState = colorBlendStateCreateInfo(json);
+    auto colorBlendState = colorBlendStateCreateInfo(description);
     pipelineInfo.pColorBlendState = &colorBlendState.info;
 
-    pipelineInfo.pDynamicState = nullptr;
+    auto dynamicState = dynamicStateCreateInfo();
+    pipelineInfo.pDynamicState = &dynamicState.info;
     pipelineInfo.layout = pipelineLayout;
-    pipelineInfo.renderPass = framebufferSet.renderPass();
+    pipelineInfo.renderPass = renderPass;
     pipelineInfo.subpass = 0;
     pipelineInfo.basePipelineHandle = nullptr;
     pipelineInfo.basePipelineIndex = -1;
 
-    vk::Pipeline pipeline =
-        static_cast<vk::Device>(device).createGraphicsPipeline(nullptr, pipelineInfo, nullptr);
-
-    for (vk::PipelineShaderStageCreateInfo info : shaderStages) {
-        static_cast<vk::Device>(device).destroyShaderModule(info.module);
-    }
+    vk::Pipeline pipeline = static_cast<vk::Device>(device).createGraphicsPipeline(
+        device.pipelineCache(), pipelineInfo, nullptr);
 
     return pipeline;
 }
 
-static DescriptorSet createDescriptorSet(DescriptorManager& descriptorManager, Texture* texture)
+// Shader loading and pipeline compilation run on the device thread pool. Everything the task
+// needs is captured by value so the Pipeline itself may be moved while the task is in flight.
+static std::shared_future<vk::Pipeline> createPipelineAsync(
+    Device& device,
+    vk::RenderPass renderPass,
+    vk::VertexInputBindingDescription bindingDescription,
+    std::vector<vk::VertexInputAttributeDescription> attributeDescriptions,
+    vk::PipelineLayout pipelineLayout,
+    const PipelineDescription& description)
 {
-    std::vector<vk::DescriptorSetLayoutBinding> bindings = {
-        {0, vk::DescriptorType::eCombinedImageSampler, 1, vk::ShaderStageFlagBits::eFragment}};
+    return device.threadPool()
+        .submit([&device,
+                 renderPass,
+                 bindingDescription,
+                 attributeDescriptions,
+                 pipelineLayout,
+                 description]() {
+            return createPipeline(
+                device,
+                renderPass,
+                bindingDescription,
+                attributeDescriptions,
+                pipelineLayout,
+                description);
+        })
+        .share();
+}
 
-    DescriptorSet descriptorSet = descriptorManager.createDescriptorSet(bindings);
+static void writeTexture(
+    DescriptorSet& descriptorSet, TextureManager& textureManager, TextureHandle texture)
+{
+    auto& bindings = descriptorSet.bindings();
+    auto samplerBinding = std::find_if(
+        bindings.begin(), bindings.end(), [](const vk::DescriptorSetLayoutBinding& binding) {
+            return binding.descriptorType == vk::DescriptorType::eCombinedImageSampler;
+        });
 
-    if (texture) {
+    if (texture.valid() && samplerBinding != bindings.end()) {
         vk::DescriptorImageInfo imageInfo{};
         imageInfo.imageLayout = vk::ImageLayout::eShaderReadOnlyOptimal;
-        imageInfo.imageView = texture->imageView();
-        imageInfo.sampler = texture->sampler();
-        descriptorSet.writeDescriptors({{0, 0, 1, &imageInfo}});
+        imageInfo.imageView = textureManager.texture(texture).imageView();
+        imageInfo.sampler = textureManager.texture(texture).sampler();
+        descriptorSet.writeDescriptors({{static_cast<int>(samplerBinding->binding), 0, 1, &imageInfo}});
     }
+}
+
+// Only shaders reading MaterialConstants know to sample the packed texture array.
+static const PackedTexture* packedTexture(
+    TextureManager& textureManager,
+    const PipelineDescription& description,
+    const PipelineReflection& reflection)
+{
+    return reflection.materialConstants ? textureManager.packedTexture(description.texture)
+                                        : nullptr;
+}
 
+// Packed textures never stream, so materials sampling the same array share one set that is never
+// rewritten.
+static std::shared_ptr<DescriptorSet> createDescriptorSet(
+    Device& device,
+    DescriptorManager& descriptorManager,
+    std::vector<vk::DescriptorSetLayoutBinding> bindings,
+    TextureManager& textureManager,
+    TextureHandle texture,
+    bool packed)
+{
+    if (bindings.empty()) {
+        return std::make_shared<DescriptorSet>(
+            device, std::vector<vk::DescriptorSetLayoutBinding>{}, nullptr, nullptr);
+    }
+
+    auto samplerBinding = std::find_if(
+        bindings.begin(), bindings.end(), [](const vk::DescriptorSetLayoutBinding& binding) {
+            return binding.descriptorType == vk::DescriptorType::eCombinedImageSampler;
+        });
+    if (packed && samplerBinding != bindings.end()) {
+        vk::DescriptorImageInfo imageInfo{};
+        imageInfo.imageLayout = vk::ImageLayout::eShaderReadOnlyOptimal;
+        imageInfo.imageView = textureManager.texture(texture).imageView();
+        imageInfo.sampler = textureManager.texture(texture).sampler();
+        return descriptorManager.sharedImageDescriptorSet(
+            bindings, samplerBinding->binding, imageInfo);
+    }
+
+    auto descriptorSet =
+        std::make_shared<DescriptorSet>(descriptorManager.createDescriptorSet(bindings));
+    writeTexture(*descriptorSet, textureManager, texture);
     return descriptorSet;
 }
 
-static Texture* createTextureFromFile(TextureManager& textureManager, const nlohmann::json& json)
+// Packed textures are already resident and shared with other materials, anything else streams.
+static TextureHandle streamTexture(
+    TextureManager& textureManager,
+    const PipelineDescription& description,
+    const PipelineReflection& reflection)
+{
+    auto packed = packedTexture(textureManager, description, reflection);
+    if (packed) {
+        textureManager.acquire(packed->texture);
+        return packed->texture;
+    } else if (!description.texture.empty()) {
+        return textureManager.streamTexture(
+            description.texture, vk::SamplerAddressMode::eRepeat, 0.0f);
+    } else {
+        return {};
+    }
+}
+
+static MaterialConstants materialConstants(
+    TextureManager& textureManager,
+    const PipelineDescription& description,
+    const PipelineReflection& reflection)
 {
-    if (hasKey(json, "texture")) {
-        return &textureManager.createTextureFromFile(
-            json["texture"], vk::SamplerAddressMode::eRepeat);
+    auto packed = packedTexture(textureManager, description, reflection);
+    if (packed) {
+        return {packed->uvTransform, packed->layer};
     } else {
-        return nullptr;
+        return {glm::vec4{1.0f, 1.0f, 0.0f, 0.0f}, 0};
     }
 }
 
@@ -443,26 +583,125 @@ Pipeline::Pipeline(
     vk::VertexInputBindingDescription bindingDescription,
     std::vector<vk::VertexInputAttributeDescription> attributeDescriptions,
     vk::DescriptorSetLayout descriptorSetLayout,
-    const nlohmann::json& json)
+    const PipelineDescription& description)
     : mDevice{device},
-      mFramebufferSet{mDevice, swapChain, depthTexture, json},
-      mTexture{createTextureFromFile(textureManager, json)},
-      mDescriptorSet{createDescriptorSet(descriptorManager, mTexture)},
-      mPipelineLayout{
-          createPipelineLayout(mDevice, descriptorSetLayout, mDescriptorSet.layout(), json)},
-      mPipeline{createPipeline(
+      mTextureManager{textureManager},
+      mFramebufferSet{mDevice, swapChain, depthTexture, description.usage},
+      mReflection{reflectPipeline(mDevice, description)},
+      mTexture{streamTexture(mTextureManager, description, mReflection)},
+      mTextureRevision{mTexture.valid() ? mTextureManager.revision(mTexture) : 0},
+      mMaterialConstants{materialConstants(mTextureManager, description, mReflection)},
+      mCullMode{description.cullMode},
+      mDescriptorSet{createDescriptorSet(
           mDevice,
-          mFramebufferSet,
+          descriptorManager,
+          materialBindings(mReflection, descriptorSetLayout),
+          mTextureManager,
+          mTexture,
+          packedTexture(mTextureManager, description, mReflection) != nullptr)},
+      mPipelineLayout{createPipelineLayout(
+          descriptorManager, descriptorSetLayout, mDescriptorSet->layout(), mReflection)},
+      mPipelineKey{
+          description,
+          swapChain.format(),
           bindingDescription,
-          attributeDescriptions,
-          swapChain.extent(),
-          mPipelineLayout,
-          json)}
+          vertexInputAttributes(attributeDescriptions, mReflection),
+          mPipelineLayout},
+      mPipeline{mDevice.pipelineLibrary().acquire(mPipelineKey, [&]() {
+          return createPipelineAsync(
+              mDevice,
+              mFramebufferSet.renderPass(),
+              mPipelineKey.bindingDescription,
+              mPipelineKey.attributeDescriptions,
+              mPipelineLayout,
+              description);
+      })}
 {
 }
 
 Pipeline::~Pipeline()
 {
-    static_cast<vk::Device>(mDevice).destroyPipeline(mPipeline);
-    static_cast<vk::Device>(mDevice).destroyPipelineLayout(mPipelineLayout);
+    // The compilation may have been started with this pipeline's render pass, which must stay
+    // alive until the compilation is done.
+    if (mPipeline.valid()) {
+        mPipeline.wait();
+        mDevice.pipelineLibrary().release(mPipelineKey);
+    }
+
+    if (mTexture.valid()) {
+        mTextureManager.release(mTexture);
+    }
+}
+
+void Pipeline::setTexturePriority(float priority)
+{
+    if (mTexture.valid()) {
+        mTextureManager.setStreamingPriority(mTexture, priority);
+    }
+}
+
+void Pipeline::markTextureUsed()
+{
+    if (mTexture.valid()) {
+        mTextureManager.markUsed(mTexture);
+    }
+}
+
+void Pipeline::pushConstants(
+    vk::CommandBuffer commandBuffer, uint32_t offset, uint32_t size, const void* data) const
+{
+    // vkCmdPushConstants must name exactly the stages whose ranges cover the pushed bytes, so
+    // the data is split wherever a range begins or ends.
+    uint32_t end = offset + size;
+    std::vector<uint32_t> edges{offset, end};
+    for (auto& range : mReflection.pushConstantRanges) {
+        for (uint32_t edge : {range.offset, range.offset + range.size}) {
+            if (edge > offset && edge < end) {
+                edges.push_back(edge);
+            }
+        }
+    }
+    std::sort(edges.begin(), edges.end());
+    edges.erase(std::unique(edges.begin(), edges.end()), edges.end());
+
+    for (size_t i = 0; i + 1 < edges.size(); i++) {
+        vk::ShaderStageFlags stages{};
+        for (auto& range : mReflection.pushConstantRanges) {
+            if (range.offset <= edges[i] && range.offset + range.size >= edges[i + 1]) {
+                stages |= range.stageFlags;
+            }
+        }
+        if (!stages) {
+            continue;
+        }
+
+        commandBuffer.pushConstants(
+            mPipelineLayout,
+            stages,
+            edges[i],
+            edges[i + 1] - edges[i],
+            static_cast<const char*>(data) + (edges[i] - offset));
+    }
+}
+
+bool Pipeline::samplesPackedTextures(Device& device, const PipelineDescription& description)
+{
+    return reflectPipeline(device, description).materialConstants;
+}
+
+void Pipeline::pushMaterialConstants(vk::CommandBuffer commandBuffer) const
+{
+    if (!mReflection.materialConstants) {
+        return;
+    }
+    pushConstants(commandBuffer, 0, sizeof(MaterialConstants), &mMaterialConstants);
+}
+
+void Pipeline::updateTexture()
+{
+    if (!mTexture.valid() || mTextureManager.revision(mTexture) == mTextureRevision) {
+        return;
+    }
+    writeTexture(*mDescriptorSet, mTextureManager, mTexture);
+    mTextureRevision = mTextureManager.revision(mTexture);
 }
@@ -0,0 +1,293 @@
+#include "../Include/PipelineDescription.h"
+#include <fstream>
+#include <json.hpp>
+
+const uint32_t pipelineDescriptionMagic = 0x53444c50; // "PLDS"
+const uint32_t pipelineDescriptionVersion = 2;
+
+static bool hasKey(const nlohmann::json& json, const std::string& key)
+{
+    return json.find(key) != json.end();
+}
+
+static PipelineUsage pipelineUsage(const std::string& usage)
+{
+    if (usage == "Default") {
+        return PipelineUsage::Default;
+    } else if (usage == "Clear") {
+        return PipelineUsage::Clear;
+    } else if (usage == "Skybox") {
+        return PipelineUsage::Skybox;
+    } else if (usage == "Quad") {
+        return PipelineUsage::Quad;
+    } else if (usage == "ShadowMap") {
+        return PipelineUsage::ShadowMap;
+    } else {
+        throw std::runtime_error{"Invalid pipeline usage: " + usage};
+    }
+}
+
+static vk::PolygonMode polygonMode(const std::string& mode)
+{
+    if (mode == "Fill") {
+        return vk::PolygonMode::eFill;
+    } else if (mode == "Line") {
+        return vk::PolygonMode::eLine;
+    } else if (mode == "Point") {
+        return vk::PolygonMode::ePoint;
+    } else {
+        throw std::runtime_error{"Invalid polygon mode.\n"};
+    }
+}
+
+static vk::CullModeFlags cullMode(const std::string& mode)
+{
+    if (mode == "None") {
+        return vk::CullModeFlagBits::eNone;
+    } else if (mode == "Front") {
+        return vk::CullModeFlagBits::eFront;
+    } else if (mode == "Back") {
+        return vk::CullModeFlagBits::eBack;
+    } else if (mode == "FrontAndBack") {
+        return vk::CullModeFlagBits::eFrontAndBack;
+    } else {
+        throw std::runtime_error{"Invalid cull mode.\n"};
+    }
+}
+
+static vk::CompareOp compareOp(const std::string& op)
+{
+    if (op == "Never") {
+        return vk::CompareOp::eNever;
+    } else if (op == "Less") {
+        return vk::CompareOp::eLess;
+    } else if (op == "Equal") {
+        return vk::CompareOp::eEqual;
+    } else if (op == "LessOrEqual") {
+        return vk::CompareOp::eLessOrEqual;
+    } else if (op == "Greater") {
+        return vk::CompareOp::eGreater;
+    } else if (op == "NotEqual") {
+        return vk::CompareOp::eNotEqual;
+    } else if (op == "GreaterOrEqual") {
+        return vk::CompareOp::eGreaterOrEqual;
+    } else if (op == "Always") {
+        return vk::CompareOp::eAlways;
+    } else {
+        throw std::runtime_error{"Invalid comparison operator.\n"};
+    }
+}
+
+PipelineDescription parsePipelineDescription(const nlohmann::json& json)
+{
+    if (!hasKey(json, "usage")) {
+        throw std::runtime_error("Pipeline description has no usage!");
+    }
+
+    PipelineDescription description{};
+    description.usage = pipelineUsage(json["usage"].get<std::string>());
+
+    if (hasKey(json, "vertexShader")) {
+        description.vertexShader = json["vertexShader"].get<std::string>();
+    }
+    if (hasKey(json, "fragmentShader")) {
+        description.fragmentShader = json["fragmentShader"].get<std::string>();
+    }
+    if (hasKey(json, "texture")) {
+        description.texture = json["texture"].get<std::string>();
+    }
+    if (hasKey(json, "polygonMode")) {
+        description.polygonMode = polygonMode(json["polygonMode"].get<std::string>());
+    }
+    if (hasKey(json, "cullMode")) {
+        description.cullMode = cullMode(json["cullMode"].get<std::string>());
+    }
+    if (hasKey(json, "depthTestEnable")) {
+        description.depthTestEnable = json["depthTestEnable"].get<bool>();
+    }
+    if (hasKey(json, "depthWriteEnable")) {
+        description.depthWriteEnable = json["depthWriteEnable"].get<bool>();
+    }
+    if (hasKey(json, "depthCompareOp")) {
+        description.depthCompareOp = compareOp(json["depthCompareOp"].get<std::string>());
+    }
+    if (hasKey(json, "specializationConstants")) {
+        for (auto& item : json["specializationConstants"].items()) {
+            SpecializationConstantDescription constant{};
+            constant.key = item.key();
+            if (item.value().is_boolean()) {
+                constant.value = item.value().get<bool>() ? 1.0 : 0.0;
+            } else {
+                constant.value = item.value().get<double>();
+            }
+            description.specializationConstants.push_back(constant);
+        }
+    }
+    if (hasKey(json, "compressedVertices")) {
+        description.compressedVertices = json["compressedVertices"].get<bool>();
+    }
+
+    return description;
+}
+
+static PipelineUsage readUsage(uint32_t value)
+{
+    if (value > static_cast<uint32_t>(PipelineUsage::ShadowMap)) {
+        throw std::runtime_error("Invalid pipeline usage in pipeline description!");
+    }
+    return static_cast<PipelineUsage>(value);
+}
+
+static vk::PolygonMode readPolygonMode(uint32_t value)
+{
+    auto mode = static_cast<vk::PolygonMode>(value);
+    if (mode != vk::PolygonMode::eFill && mode != vk::PolygonMode::eLine &&
+        mode != vk::PolygonMode::ePoint) {
+        throw std::runtime_error("Invalid polygon mode in pipeline description!");
+    }
+    return mode;
+}
+
+static vk::CullModeFlags readCullMode(uint32_t value)
+{
+    if (value & ~static_cast<uint32_t>(VK_CULL_MODE_FRONT_AND_BACK)) {
+        throw std::runtime_error("Invalid cull mode in pipeline description!");
+    }
+    return static_cast<vk::CullModeFlags>(value);
+}
+
+static vk::CompareOp readCompareOp(uint32_t value)
+{
+    if (value > static_cast<uint32_t>(vk::CompareOp::eAlways)) {
+        throw std::runtime_error("Invalid comparison operator in pipeline description!");
+    }
+    return static_cast<vk::CompareOp>(value);
+}
+
+struct DescriptionReader {
+    const std::vector<char>& data;
+    size_t offset;
+
+    template <typename T>
+    T read()
+    {
+        if (offset + sizeof(T) > data.size()) {
+            throw std::runtime_error("Truncated pipeline description!");
+        }
+        T value{};
+        memcpy(&value, data.data() + offset, sizeof(T));
+        offset += sizeof(T);
+        return value;
+    }
+
+    std::string readString()
+    {
+        uint32_t length = read<uint32_t>();
+        if (offset + length > data.size()) {
+            throw std::runtime_error("Truncated pipeline description!");
+        }
+        std::string value{data.data() + offset, length};
+        offset += length;
+        return value;
+    }
+};
+
+static bool isCompiledPipelineDescription(const std::vector<char>& data)
+{
+    uint32_t magic = 0;
+    if (data.size() < sizeof(magic)) {
+        return false;
+    }
+    memcpy(&magic, data.data(), sizeof(magic));
+    return magic == pipelineDescriptionMagic;
+}
+
+PipelineDescription readPipelineDescription(const std::vector<char>& data)
+{
+    DescriptionReader reader{data, 0};
+
+    if (reader.read<uint32_t>() != pipelineDescriptionMagic) {
+        throw std::runtime_error("Not a compiled pipeline description!");
+    }
+    // Version 1 files predate compressedVertices and are read with it disabled.
+    uint32_t version = reader.read<uint32_t>();
+    if (version < 1 || version > pipelineDescriptionVersion) {
+        throw std::runtime_error("Unsupported pipeline description version!");
+    }
+
+    PipelineDescription description{};
+    description.usage = readUsage(reader.read<uint32_t>());
+    description.vertexShader = reader.readString();
+    description.fragmentShader = reader.readString();
+    description.texture = reader.readString();
+    description.polygonMode = readPolygonMode(reader.read<uint32_t>());
+    description.cullMode = readCullMode(reader.read<uint32_t>());
+    description.depthTestEnable = reader.read<uint32_t>() != 0;
+    description.depthWriteEnable = reader.read<uint32_t>() != 0;
+    description.depthCompareOp = readCompareOp(reader.read<uint32_t>());
+
+    uint32_t constantCount = reader.read<uint32_t>();
+    for (uint32_t i = 0; i < constantCount; i++) {
+        SpecializationConstantDescription constant{};
+        constant.key = reader.readString();
+        constant.value = reader.read<double>();
+        description.specializationConstants.push_back(constant);
+    }
+
+    if (version >= 2) {
+        description.compressedVertices = reader.read<uint32_t>() != 0;
+    }
+
+    return description;
+}
+
+template <typename T>
+static void write(std::ofstream& file, T value)
+{
+    file.write(reinterpret_cast<const char*>(&value), sizeof(T));
+}
+
+static void writeString(std::ofstream& file, const std::string& value)
+{
+    write(file, static_cast<uint32_t>(value.size()));
+    file.write(value.data(), value.size());
+}
+
+void writePipelineDescription(const std::string& filename, const PipelineDescription& description)
+{
+    std::ofstream file(filename, std::ios::out | std::ios::binary);
+    if (!file.is_open()) {
+        throw std::runtime_error("Failed to open pipeline description for writing!");
+    }
+
+    write(file, pipelineDescriptionMagic);
+    write(file, pipelineDescriptionVersion);
+    write(file, static_cast<uint32_t>(description.usage));
+    writeString(file, description.vertexShader);
+    writeString(file, description.fragmentShader);
+    writeString(file, description.texture);
+    write(file, static_cast<uint32_t>(description.polygonMode));
+    write(file, static_cast<uint32_t>(static_cast<VkCullModeFlags>(description.cullMode)));
+    write(file, static_cast<uint32_t>(description.depthTestEnable));
+    write(file, static_cast<uint32_t>(description.depthWriteEnable));
+    write(file, static_cast<uint32_t>(description.depthCompareOp));
+
+    write(file, static_cast<uint32_t>(description.specializationConstants.size()));
+    for (auto& constant : description.specializationConstants) {
+        writeString(file, constant.key);
+        write(file, constant.value);
+    }
+
+    write(file, static_cast<uint32_t>(description.compressedVertices));
+}
+
+PipelineDescription loadPipelineDescription(const std::string& filename)
+{
+    auto data = readFile(filename);
+
+    if (isCompiledPipelineDescription(data)) {
+        return readPipelineDescription(data);
+    }
+
+    return parsePipelineDescription(nlohmann::json::parse(data.begin(), data.end()));
+}
@@ -0,0 +1,130 @@
+#include "../Include/PipelineLibrary.h"
+#include <algorithm>
+#include <iostream>
+
+static bool sameSpecializationConstants(
+    const std::vector<SpecializationConstantDescription>& lhs,
+    const std::vector<SpecializationConstantDescription>& rhs)
+{
+    return std::equal(
+        lhs.begin(),
+        lhs.end(),
+        rhs.begin(),
+        rhs.end(),
+        [](const SpecializationConstantDescription& a, const SpecializationConstantDescription& b) {
+            return a.key == b.key && a.value == b.value;
+        });
+}
+
+bool PipelineKey::operator==(const PipelineKey& rhs) const
+{
+    const PipelineDescription& lhsDescription = description;
+    const PipelineDescription& rhsDescription = rhs.description;
+    return lhsDescription.usage == rhsDescription.usage &&
+        lhsDescription.vertexShader == rhsDescription.vertexShader &&
+        lhsDescription.fragmentShader == rhsDescription.fragmentShader &&
+        lhsDescription.polygonMode == rhsDescription.polygonMode &&
+        lhsDescription.cullMode == rhsDescription.cullMode &&
+        lhsDescription.depthTestEnable == rhsDescription.depthTestEnable &&
+        lhsDescription.depthWriteEnable == rhsDescription.depthWriteEnable &&
+        lhsDescription.depthCompareOp == rhsDescription.depthCompareOp &&
+        sameSpecializationConstants(
+            lhsDescription.specializationConstants, rhsDescription.specializationConstants) &&
+        colorFormat == rhs.colorFormat && bindingDescription == rhs.bindingDescription &&
+        attributeDescriptions == rhs.attributeDescriptions && layout == rhs.layout;
+}
+
+template <typename T>
+static void hashCombine(size_t& hash, const T& value)
+{
+    hash ^= std::hash<T>{}(value) + 0x9e3779b9 + (hash << 6) + (hash >> 2);
+}
+
+size_t PipelineKeyHash::operator()(const PipelineKey& key) const
+{
+    const PipelineDescription& description = key.description;
+    size_t hash = 0;
+    hashCombine(hash, static_cast<uint32_t>(description.usage));
+    hashCombine(hash, description.vertexShader);
+    hashCombine(hash, description.fragmentShader);
+    hashCombine(hash, static_cast<uint32_t>(description.polygonMode));
+    hashCombine(hash, static_cast<uint32_t>(description.cullMode));
+    hashCombine(hash, description.depthTestEnable);
+    hashCombine(hash, description.depthWriteEnable);
+    hashCombine(hash, static_cast<uint32_t>(description.depthCompareOp));
+    for (auto& constant : description.specializationConstants) {
+        hashCombine(hash, constant.key);
+        hashCombine(hash, constant.value);
+    }
+    hashCombine(hash, static_cast<uint32_t>(key.colorFormat));
+    hashCombine(hash, key.bindingDescription.stride);
+    for (auto& attribute : key.attributeDescriptions) {
+        hashCombine(hash, attribute.location);
+        hashCombine(hash, static_cast<uint32_t>(attribute.format));
+        hashCombine(hash, attribute.offset);
+    }
+    hashCombine(hash, static_cast<VkPipelineLayout>(key.layout));
+    return hash;
+}
+
+PipelineLibrary::PipelineLibrary(vk::Device device) : mDevice{device}
+{
+}
+
+PipelineLibrary::~PipelineLibrary()
+{
+    clear();
+}
+
+std::shared_future<vk::Pipeline> PipelineLibrary::acquire(
+    const PipelineKey& key, const std::function<std::shared_future<vk::Pipeline>()>& compile)
+{
+    std::lock_guard<std::mutex> lock{mMutex};
+
+    auto it = mPipelines.find(key);
+    if (it == mPipelines.end()) {
+        it = mPipelines.emplace(key, Entry{compile(), 0}).first;
+    }
+    it->second.refCount++;
+    return it->second.pipeline;
+}
+
+void PipelineLibrary::release(const PipelineKey& key)
+{
+    std::shared_future<vk::Pipeline> pipeline{};
+    {
+        std::lock_guard<std::mutex> lock{mMutex};
+
+        auto it = mPipelines.find(key);
+        if (it == mPipelines.end()) {
+            throw std::runtime_error("Releasing a pipeline that was never acquired!");
+        }
+        if (--it->second.refCount > 0) {
+            return;
+        }
+        pipeline = std::move(it->second.pipeline);
+        mPipelines.erase(it);
+    }
+
+    destroyPipeline(pipeline);
+}
+
+void PipelineLibrary::clear()
+{
+    std::lock_guard<std::mutex> lock{mMutex};
+
+    for (auto& pipeline : mPipelines) {
+        destroyPipeline(pipeline.second.pipeline);
+    }
+    mPipelines.clear();
+}
+
+// Waits for compilation, which has to finish before the pipeline can be destroyed.
+void PipelineLibrary::destroyPipeline(const std::shared_future<vk::Pipeline>& pipeline)
+{
+    try {
+        mDevice.destroyPipeline(pipeline.get());
+    } catch (const std::exception& e) {
+        std::cout << "Pipeline compilation failed: " << e.what() << "\n";
+    }
+}
@@ -62,6 +62,15 @@ static DescriptorSet createDescriptorSet(
     return descriptorSet;
 }
 
+static PipelineDescription pipelineDescription()
+{
+    PipelineDescription description{};
+    description.usage = PipelineUsage::Quad;
+    description.vertexShader = "d:/Shaders/quadvert.spv";
+    description.fragmentShader = "d:/Shaders/quadfrag.spv";
+    return description;
+}
+
 Quad::Quad(
     Device& device,
     DescriptorManager& descriptorManager,
@@ -82,9 +91,7 @@ Quad::Quad(
           QuadVertex::bindingDescription(),
           QuadVertex::attributeDescriptions(),
           mDescriptorSet.layout(),
-          {{"vertexShader", "d:/Shaders/quadvert.spv"},
-           {"fragmentShader", "d:/Shaders/quadfrag.spv"},
-           {"usage", "Quad"}}}
+          pipelineDescription()}
 {
     std::cout << "Quad constructed\n";
 }
@@ -3,11 +3,14 @@
 #include "../Include/Device.h"
 #include "../Include/DirectionalLight.h"
 #include "../Include/FramebufferSet.h"
+#include "../Include/Material.h"
 #include "../Include/Mesh.h"
+#include "../Include/Pipeline.h"
 #include "../Include/Quad.h"
 #include "../Include/Skybox.h"
 #include "../Include/SwapChain.h"
 #include "../Include/Texture.h"
+#include <algorithm>
 #include <fstream>
 #include <iostream>
 
@@ -28,7 +31,7 @@ Renderer::Renderer(Device& device, SwapChain& swapChain, Texture& depthTexture)
     : mDevice{device},
       mSwapChain{swapChain},
       mDepthTexture{depthTexture},
-      mClearFramebufferSet{mDevice, mSwapChain, &mDepthTexture, {{"usage", "Clear"}}},
+      mClearFramebufferSet{mDevice, mSwapChain, &mDepthTexture, PipelineUsage::Clear},
       mCommandBuffers{createCommandBuffers(device, swapChain)},
       mImageAvailableSemaphore{static_cast<vk::Device>(mDevice).createSemaphore({})},
       mRenderFinishedSemaphore{static_cast<vk::Device>(mDevice).createSemaphore({})}
@@ -193,33 +196,81 @@ static void clearPass(
 
 float t2 = 1.0f;
 
+// Binds the object's set 0 and the pipeline's material set 1. Pipelines whose shaders read no
+// material bindings have no material set in the layout.
+static void bindDescriptorSets(
+    vk::CommandBuffer commandBuffer, Pipeline& pipeline, vk::DescriptorSet objectSet)
+{
+    std::vector<vk::DescriptorSet> descriptorSets{objectSet};
+    vk::DescriptorSet materialSet = pipeline.descriptorSet();
+    if (materialSet) {
+        descriptorSets.push_back(materialSet);
+    }
+    commandBuffer.bindDescriptorSets(
+        vk::PipelineBindPoint::eGraphics, pipeline.layout(), 0, descriptorSets, nullptr);
+}
+
+// Meshes are drawn in runs sharing a material, so the pipeline, the material set and the material
+// constants are bound once per run and only the object set changes between meshes.
 static void drawModelsPass(
     vk::CommandBuffer commandBuffer,
     int framebufferIndex,
     vk::Extent2D swapChainExtent,
-    std::vector<Mesh>& models)
+    std::vector<Mesh>& models,
+    MaterialCache& materialCache)
 {
+    std::vector<Mesh*> sortedModels{};
     for (Mesh& model : models) {
+        sortedModels.push_back(&model);
+    }
+    std::stable_sort(sortedModels.begin(), sortedModels.end(), [](Mesh* lhs, Mesh* rhs) {
+        return lhs->material() < rhs->material();
+    });
+
+    for (auto run = sortedModels.begin(); run != sortedModels.end();) {
+        MaterialHandle material = (*run)->material();
+        auto runEnd = std::find_if(run, sortedModels.end(), [material](Mesh* model) {
+            return !(model->material() == material);
+        });
+
+        // Pipelines compile in the background; skip the run until its pipeline is ready.
+        Pipeline& pipeline = materialCache.pipeline(material);
+        if (!pipeline.ready()) {
+            run = runEnd;
+            continue;
+        }
+        pipeline.markTextureUsed();
+
         vk::RenderPassBeginInfo renderPassInfo;
-        renderPassInfo.renderPass = models.front().pipeline().framebufferSet().renderPass();
-        renderPassInfo.framebuffer =
-            models.front().pipeline().framebufferSet().frameBuffer(framebufferIndex);
+        renderPassInfo.renderPass = pipeline.framebufferSet().renderPass();
+        renderPassInfo.framebuffer = pipeline.framebufferSet().frameBuffer(framebufferIndex);
         renderPassInfo.renderArea.offset = vk::Offset2D(0, 0);
         renderPassInfo.renderArea.extent = swapChainExtent;
 
         commandBuffer.beginRenderPass(renderPassInfo, vk::SubpassContents::eInline);
-        commandBuffer.bindPipeline(vk::PipelineBindPoint::eGraphics, model.pipeline());
-        commandBuffer.bindVertexBuffers(0, {model.vertexBuffer()}, {0});
-        commandBuffer.bindIndexBuffer(model.indexBuffer(), 0, vk::IndexType::eUint32);
-
-        commandBuffer.bindDescriptorSets(
-            vk::PipelineBindPoint::eGraphics,
-            model.pipeline().layout(),
-            0,
-            {model.descriptorSet(), model.pipeline().descriptorSet()},
-            nullptr);
-
-        commandBuffer.drawIndexed(static_cast<uint32_t>(model.indexCount()), 1, 0, 0, 0);
+        commandBuffer.bindPipeline(vk::PipelineBindPoint::eGraphics, pipeline);
+        setViewportAndScissor(commandBuffer, swapChainExtent);
+
+        vk::DescriptorSet materialSet = pipeline.descriptorSet();
+        if (materialSet) {
+            commandBuffer.bindDescriptorSets(
+                vk::PipelineBindPoint::eGraphics, pipeline.layout(), 1, materialSet, nullptr);
+        }
+        pipeline.pushMaterialConstants(commandBuffer);
+
+        for (; run != runEnd; ++run) {
+            Mesh& model = **run;
+            commandBuffer.bindVertexBuffers(0, {model.vertexBuffer()}, {0});
+            commandBuffer.bindIndexBuffer(model.indexBuffer(), 0, model.indexType());
+            commandBuffer.bindDescriptorSets(
+                vk::PipelineBindPoint::eGraphics,
+                pipeline.layout(),
+                0,
+                model.descriptorSet(),
+                nullptr);
+
+            model.draw(commandBuffer);
+        }
 
         commandBuffer.endRenderPass();
     }
@@ -239,22 +290,11 @@ static void drawSkyboxPass(
 
     commandBuffer.beginRenderPass(renderPassInfo, vk::SubpassContents::eInline);
     commandBuffer.bindPipeline(vk::PipelineBindPoint::eGraphics, skybox.pipeline());
+    setViewportAndScissor(commandBuffer, swapChainExtent);
     commandBuffer.bindVertexBuffers(0, {skybox.vertexBuffer()}, {0});
     commandBuffer.bindIndexBuffer(skybox.indexBuffer(), 0, vk::IndexType::eUint32);
 
-    commandBuffer.bindDescriptorSets(
-        vk::PipelineBindPoint::eGraphics,
-        skybox.pipeline().layout(),
-        0,
-        {skybox.descriptorSet()},
-        nullptr);
-
-    commandBuffer.bindDescriptorSets(
-        vk::PipelineBindPoint::eGraphics,
-        skybox.pipeline().layout(),
-        1,
-        {skybox.pipeline().descriptorSet()},
-        nullptr);
+    bindDescriptorSets(commandBuffer, skybox.pipeline(), skybox.descriptorSet());
 
     //commandBuffer.draw(36, 1, 0, 0);
     commandBuffer.drawIndexed(36, 1, 0, 0, 0);
@@ -273,21 +313,10 @@ static void drawQuadPass(
 
     commandBuffer.beginRenderPass(renderPassInfo, vk::SubpassContents::eInline);
     commandBuffer.bindPipeline(vk::PipelineBindPoint::eGraphics, quad.pipeline());
+    setViewportAndScissor(commandBuffer, swapChainExtent);
     commandBuffer.bindVertexBuffers(0, {quad.vertexBuffer()}, {0});
 
-    commandBuffer.bindDescriptorSets(
-        vk::PipelineBindPoint::eGraphics,
-        quad.pipeline().layout(),
-        0,
-        {quad.descriptorSet()},
-        nullptr);
-
-    commandBuffer.bindDescriptorSets(
-        vk::PipelineBindPoint::eGraphics,
-        quad.pipeline().layout(),
-        1,
-        {quad.pipeline().descriptorSet()},
-        nullptr);
+    bindDescriptorSets(commandBuffer, quad.pipeline(), quad.descriptorSet());
 
     commandBuffer.draw(6, 1, 0, 0);
 
@@ -295,7 +324,11 @@ static void drawQuadPass(
 }
 
 void Renderer::drawFrame(
-    std::vector<Mesh>& models, Skybox& skybox, Quad& quad, DirectionalLight& light)
+    std::vector<Mesh>& models,
+    MaterialCache& materialCache,
+    Skybox& skybox,
+    Quad& quad,
+    DirectionalLight& light)
 {
     uint32_t imageIndex = 0;
     static_cast<vk::Device>(mDevice).acquireNextImageKHR(
@@ -317,7 +350,7 @@ void Renderer::drawFrame(
         mClearFramebufferSet.frameBuffer(imageIndex),
         mSwapChain.extent());
 
-    drawModelsPass(commandBuffer, imageIndex, mSwapChain.extent(), models);
+    drawModelsPass(commandBuffer, imageIndex, mSwapChain.extent(), models, materialCache);
     //drawSkyboxPass(commandBuffer, imageIndex, mSwapChain.extent(), skybox);
     //drawQuadPass(commandBuffer, imageIndex, mSwapChain.extent(), quad);
 
@@ -0,0 +1,95 @@
+#include "../Include/SamplerCache.h"
+#include <functional>
+
+bool SamplerState::operator==(const SamplerState& rhs) const
+{
+    return magFilter == rhs.magFilter && minFilter == rhs.minFilter &&
+        mipmapMode == rhs.mipmapMode && addressModeU == rhs.addressModeU &&
+        addressModeV == rhs.addressModeV && addressModeW == rhs.addressModeW &&
+        mipLodBias == rhs.mipLodBias && anisotropyEnable == rhs.anisotropyEnable &&
+        maxAnisotropy == rhs.maxAnisotropy && compareEnable == rhs.compareEnable &&
+        compareOp == rhs.compareOp && minLod == rhs.minLod && maxLod == rhs.maxLod &&
+        borderColor == rhs.borderColor && unnormalizedCoordinates == rhs.unnormalizedCoordinates;
+}
+
+template <typename T>
+static void hashCombine(size_t& hash, const T& value)
+{
+    hash ^= std::hash<T>{}(value) + 0x9e3779b9 + (hash << 6) + (hash >> 2);
+}
+
+size_t SamplerStateHash::operator()(const SamplerState& state) const
+{
+    size_t hash = 0;
+    hashCombine(hash, static_cast<uint32_t>(state.magFilter));
+    hashCombine(hash, static_cast<uint32_t>(state.minFilter));
+    hashCombine(hash, static_cast<uint32_t>(state.mipmapMode));
+    hashCombine(hash, static_cast<uint32_t>(state.addressModeU));
+    hashCombine(hash, static_cast<uint32_t>(state.addressModeV));
+    hashCombine(hash, static_cast<uint32_t>(state.addressModeW));
+    hashCombine(hash, state.mipLodBias);
+    hashCombine(hash, state.anisotropyEnable);
+    hashCombine(hash, state.maxAnisotropy);
+    hashCombine(hash, state.compareEnable);
+    hashCombine(hash, static_cast<uint32_t>(state.compareOp));
+    hashCombine(hash, state.minLod);
+    hashCombine(hash, state.maxLod);
+    hashCombine(hash, static_cast<uint32_t>(state.borderColor));
+    hashCombine(hash, state.unnormalizedCoordinates);
+    return hash;
+}
+
+SamplerState samplerState(vk::SamplerAddressMode addressMode)
+{
+    SamplerState state{};
+    state.addressModeU = addressMode;
+    state.addressModeV = addressMode;
+    state.addressModeW = addressMode;
+    return state;
+}
+
+SamplerCache::SamplerCache(vk::Device device) : mDevice{device}
+{
+}
+
+SamplerCache::~SamplerCache()
+{
+    clear();
+}
+
+vk::Sampler SamplerCache::sampler(const SamplerState& state)
+{
+    auto it = mSamplers.find(state);
+    if (it != mSamplers.end()) {
+        return it->second;
+    }
+
+    vk::SamplerCreateInfo samplerInfo{};
+    samplerInfo.magFilter = state.magFilter;
+    samplerInfo.minFilter = state.minFilter;
+    samplerInfo.mipmapMode = state.mipmapMode;
+    samplerInfo.addressModeU = state.addressModeU;
+    samplerInfo.addressModeV = state.addressModeV;
+    samplerInfo.addressModeW = state.addressModeW;
+    samplerInfo.mipLodBias = state.mipLodBias;
+    samplerInfo.anisotropyEnable = state.anisotropyEnable;
+    samplerInfo.maxAnisotropy = state.maxAnisotropy;
+    samplerInfo.compareEnable = state.compareEnable;
+    samplerInfo.compareOp = state.compareOp;
+    samplerInfo.minLod = state.minLod;
+    samplerInfo.maxLod = state.maxLod;
+    samplerInfo.borderColor = state.borderColor;
+    samplerInfo.unnormalizedCoordinates = state.unnormalizedCoordinates;
+
+    vk::Sampler sampler = mDevice.createSampler(samplerInfo);
+    mSamplers.emplace(state, sampler);
+    return sampler;
+}
+
+void SamplerCache::clear()
+{
+    for (auto& sampler : mSamplers) {
+        mDevice.destroySampler(sampler.second);
+    }
+    mSamplers.clear();
+}
@@ -0,0 +1,257 @@
+#include "../Include/ShaderLibrary.h"
+#include <fstream>
+#include <iostream>
+#include <spirv_cross.hpp>
+#include <vulkan/vulkan.hpp>
+
+const uint32_t spirvMagic = 0x07230203;
+
+static std::vector<uint32_t> readSpirvFile(const std::string& filename)
+{
+    std::vector<char> buffer = readFile(filename);
+
+    if (buffer.empty() || buffer.size() % sizeof(uint32_t) != 0) {
+        throw std::runtime_error("Invalid SPIR-V file size: " + filename);
+    }
+
+    std::vector<uint32_t> buffer32(buffer.size() / sizeof(uint32_t));
+    memcpy(buffer32.data(), buffer.data(), buffer.size());
+
+    if (buffer32.front() != spirvMagic) {
+        throw std::runtime_error("Invalid SPIR-V magic number: " + filename);
+    }
+    return buffer32;
+}
+
+static uint64_t hashSpirv(const std::vector<uint32_t>& code)
+{
+    uint64_t hash = 14695981039346656037ull;
+    const uint8_t* bytes = reinterpret_cast<const uint8_t*>(code.data());
+    for (size_t i = 0; i < code.size() * sizeof(uint32_t); i++) {
+        hash ^= bytes[i];
+        hash *= 1099511628211ull;
+    }
+    return hash;
+}
+
+static vk::ShaderStageFlagBits shaderStage(spv::ExecutionModel executionModel)
+{
+    switch (executionModel) {
+    case spv::ExecutionModelVertex:
+        return vk::ShaderStageFlagBits::eVertex;
+    case spv::ExecutionModelTessellationControl:
+        return vk::ShaderStageFlagBits::eTessellationControl;
+    case spv::ExecutionModelTessellationEvaluation:
+        return vk::ShaderStageFlagBits::eTessellationEvaluation;
+    case spv::ExecutionModelGeometry:
+        return vk::ShaderStageFlagBits::eGeometry;
+    case spv::ExecutionModelFragment:
+        return vk::ShaderStageFlagBits::eFragment;
+    case spv::ExecutionModelGLCompute:
+        return vk::ShaderStageFlagBits::eCompute;
+    default:
+        throw std::runtime_error("Unsupported shader execution model!");
+    }
+}
+
+static SpecializationConstantType specializationConstantType(const spirv_cross::SPIRType& type)
+{
+    switch (type.basetype) {
+    case spirv_cross::SPIRType::Boolean:
+        return SpecializationConstantType::Bool;
+    case spirv_cross::SPIRType::Int:
+        return SpecializationConstantType::Int;
+    case spirv_cross::SPIRType::UInt:
+        return SpecializationConstantType::UInt;
+    case spirv_cross::SPIRType::Float:
+        return SpecializationConstantType::Float;
+    default:
+        throw std::runtime_error("Unsupported specialization constant type!");
+    }
+}
+
+template <typename Resources>
+static void reflectDescriptorBindings(
+    const spirv_cross::Compiler& compiler,
+    const Resources& resources,
+    vk::DescriptorType type,
+    ShaderReflection& reflection)
+{
+    for (auto& resource : resources) {
+        DescriptorBindingReflection binding{};
+        binding.name = resource.name;
+        binding.set = compiler.get_decoration(resource.id, spv::DecorationDescriptorSet);
+        binding.binding.binding = compiler.get_decoration(resource.id, spv::DecorationBinding);
+        binding.binding.descriptorType = type;
+        binding.binding.descriptorCount = 1;
+        binding.binding.stageFlags = reflection.stage;
+
+        for (auto size : compiler.get_type(resource.type_id).array) {
+            binding.binding.descriptorCount *= size;
+        }
+        reflection.descriptorBindings.push_back(binding);
+    }
+}
+
+static std::vector<UniformMemberReflection> reflectStructMembers(
+    const spirv_cross::Compiler& compiler, const spirv_cross::SPIRType& type)
+{
+    std::vector<UniformMemberReflection> members{};
+    for (uint32_t i = 0; i < type.member_types.size(); i++) {
+        UniformMemberReflection member{};
+        member.name = compiler.get_member_name(type.self, i);
+        member.offset = compiler.type_struct_member_offset(type, i);
+        member.size = compiler.get_declared_struct_member_size(type, i);
+
+        auto& memberType = compiler.get_type(type.member_types[i]);
+        if (!memberType.array.empty()) {
+            member.arrayStride = compiler.type_struct_member_array_stride(type, i);
+        } else {
+            member.arrayStride = 0;
+        }
+        members.push_back(member);
+    }
+    return members;
+}
+
+static ShaderReflection reflectShader(const std::vector<uint32_t>& code)
+{
+    spirv_cross::Compiler compiler(code);
+    spirv_cross::ShaderResources resources = compiler.get_shader_resources();
+
+    ShaderReflection reflection{};
+    reflection.stage = shaderStage(compiler.get_execution_model());
+
+    reflectDescriptorBindings(
+        compiler, resources.uniform_buffers, vk::DescriptorType::eUniformBuffer, reflection);
+    reflectDescriptorBindings(
+        compiler, resources.storage_buffers, vk::DescriptorType::eStorageBuffer, reflection);
+    reflectDescriptorBindings(
+        compiler, resources.sampled_images, vk::DescriptorType::eCombinedImageSampler, reflection);
+    reflectDescriptorBindings(
+        compiler, resources.separate_images, vk::DescriptorType::eSampledImage, reflection);
+    reflectDescriptorBindings(
+        compiler, resources.separate_samplers, vk::DescriptorType::eSampler, reflection);
+    reflectDescriptorBindings(
+        compiler, resources.storage_images, vk::DescriptorType::eStorageImage, reflection);
+
+    // The range covers the whole declared block, so pushing any member of it stays valid even
+    // when the shader only reads some of the members.
+    for (auto& buffer : resources.push_constant_buffers) {
+        auto& type = compiler.get_type(buffer.base_type_id);
+        if (type.member_types.empty()) {
+            continue;
+        }
+
+        uint32_t begin = compiler.type_struct_member_offset(type, 0);
+        uint32_t end = static_cast<uint32_t>(compiler.get_declared_struct_size(type));
+        reflection.pushConstantRanges.push_back({reflection.stage, begin, end - begin});
+
+        auto members = reflectStructMembers(compiler, type);
+        reflection.pushConstantMembers.insert(
+            reflection.pushConstantMembers.end(), members.begin(), members.end());
+    }
+
+    if (reflection.stage == vk::ShaderStageFlagBits::eVertex) {
+        for (auto& input : resources.stage_inputs) {
+            if (compiler.has_decoration(input.id, spv::DecorationBuiltIn)) {
+                continue;
+            }
+            reflection.inputLocations.push_back(
+                compiler.get_decoration(input.id, spv::DecorationLocation));
+        }
+    }
+
+    for (auto& constant : compiler.get_specialization_constants()) {
+        SpecializationConstantReflection specializationConstant{};
+        specializationConstant.name = compiler.get_name(constant.id);
+        specializationConstant.constantId = constant.constant_id;
+        specializationConstant.type = specializationConstantType(
+            compiler.get_type(compiler.get_constant(constant.id).constant_type));
+        reflection.specializationConstants.push_back(specializationConstant);
+    }
+
+    for (auto& buffer : resources.uniform_buffers) {
+        UniformBufferReflection uniformBuffer{};
+        uniformBuffer.name = buffer.name;
+        uniformBuffer.set = compiler.get_decoration(buffer.id, spv::DecorationDescriptorSet);
+        uniformBuffer.binding = compiler.get_decoration(buffer.id, spv::DecorationBinding);
+
+        auto& type = compiler.get_type(buffer.base_type_id);
+        uniformBuffer.size = compiler.get_declared_struct_size(type);
+        uniformBuffer.members = reflectStructMembers(compiler, type);
+        reflection.uniformBuffers.push_back(uniformBuffer);
+    }
+
+    return reflection;
+}
+
+ShaderLibrary::ShaderLibrary(vk::Device device) : mDevice{device}
+{
+}
+
+ShaderLibrary::~ShaderLibrary()
+{
+    clear();
+}
+
+const Shader& ShaderLibrary::shader(const std::string& filename)
+{
+    {
+        std::lock_guard<std::mutex> lock{mMutex};
+        auto it = mShadersByFilename.find(filename);
+        if (it != mShadersByFilename.end()) {
+            return *it->second;
+        }
+    }
+
+    // File I/O and reflection happen outside the lock so workers can load different files
+    // concurrently. If two threads race on the same file the first one to insert wins.
+    auto code = readSpirvFile(filename);
+    uint64_t hash = hashSpirv(code);
+    ShaderReflection reflection = reflectShader(code);
+
+    std::lock_guard<std::mutex> lock{mMutex};
+    auto it = mShadersByFilename.find(filename);
+    if (it != mShadersByFilename.end()) {
+        return *it->second;
+    }
+
+    // A hash match only shares the module when the code is identical, so a collision costs a
+    // duplicate module instead of binding the wrong shader.
+    auto& candidates = mShadersByHash[hash];
+    for (auto& candidate : candidates) {
+        if (candidate->code == code) {
+            mShadersByFilename[filename] = candidate.get();
+            return *candidate;
+        }
+    }
+
+    vk::ShaderModuleCreateInfo createInfo{};
+    createInfo.codeSize = code.size() * sizeof(uint32_t);
+    createInfo.pCode = code.data();
+
+    auto shader = std::make_unique<Shader>();
+    shader->filename = filename;
+    shader->hash = hash;
+    shader->module = mDevice.createShaderModule(createInfo, nullptr);
+    shader->code = std::move(code);
+    shader->reflection = std::move(reflection);
+    std::cout << "Shader loaded " << filename << "\n";
+
+    mShadersByFilename[filename] = shader.get();
+    candidates.push_back(std::move(shader));
+    return *candidates.back();
+}
+
+void ShaderLibrary::clear()
+{
+    std::lock_guard<std::mutex> lock{mMutex};
+    for (auto& candidates : mShadersByHash) {
+        for (auto& shader : candidates.second) {
+            mDevice.destroyShaderModule(shader->module);
+        }
+    }
+    mShadersByHash.clear();
+    mShadersByFilename.clear();
+}
@@ -92,6 +92,20 @@ static DescriptorSet createDescriptorSet(
     return descriptorSet;
 }
 
+static PipelineDescription pipelineDescription()
+{
+    PipelineDescription description{};
+    description.usage = PipelineUsage::Skybox;
+    description.vertexShader = "d:/Shaders/skyboxvert.spv";
+    description.fragmentShader = "d:/Shaders/skyboxfrag.spv";
+    description.texture = "d:/skybox/left.jpg";
+    description.cullMode = vk::CullModeFlagBits::eBack;
+    description.depthTestEnable = true;
+    description.depthWriteEnable = true;
+    description.depthCompareOp = vk::CompareOp::eLessOrEqual;
+    return description;
+}
+
 Skybox::Skybox(
     Device& device,
     DescriptorManager& descriptorManager,
@@ -112,14 +126,7 @@ Skybox::Skybox(
           SkyboxVertex::bindingDescription(),
           SkyboxVertex::attributeDescriptions(),
           mDescriptorSet.layout(),
-          {{"vertexShader", "d:/Shaders/skyboxvert.spv"},
-           {"fragmentShader", "d:/Shaders/skyboxfrag.spv"},
-           {"texture", "d:/skybox/left.jpg"},
-           {"usage", "Skybox"},
-           {"depthCompareOp", "LessOrEqual"},
-           {"depthTestEnable", true},
-           {"depthWriteEnable", true},
-           {"cullMode", "Back"}}}
+          pipelineDescription()}
 {
     mUniform.world = glm::mat4{1.0f};
     std::cout << "Skybox constructed.\n";
@@ -3,6 +3,7 @@
 #include "../Include/Base.h"
 #include "../Include/Buffer.h"
 #include "../Include/Device.h"
+#include <algorithm>
 #include <iostream>
 #include <vulkan/vulkan.hpp>
 
@@ -11,6 +12,7 @@ Texture::Texture(Texture&& rhs)
       mType{rhs.mType},
       mLayerCount{rhs.mLayerCount},
       mExtent{rhs.mExtent},
+      mMipLevels{rhs.mMipLevels},
       mFormat{rhs.mFormat},
       mImage{rhs.mImage},
       mMemory{rhs.mMemory},
@@ -20,7 +22,6 @@ Texture::Texture(Texture&& rhs)
     rhs.mImage = nullptr;
     rhs.mMemory = nullptr;
     rhs.mImageView = nullptr;
-    rhs.mSampler = nullptr;
 }
 
 vk::ImageType imageType(vk::ImageViewType type)
@@ -46,7 +47,7 @@ vk::ImageType imageType(vk::ImageViewType type)
 
 vk::ImageCreateFlags imageCreateFlags(vk::ImageViewType viewType)
 {
-    if (viewType == vk::ImageViewType::eCube) {
+    if (viewType == vk::ImageViewType::eCube || viewType == vk::ImageViewType::eCubeArray) {
         return vk::ImageCreateFlagBits::eCubeCompatible;
     } else {
         return {};
@@ -60,16 +61,18 @@ static vk::Image createImage(
     vk::Extent3D extent,
     vk::Format format,
     vk::ImageTiling tiling,
-    vk::ImageUsageFlags usage)
+    vk::ImageUsageFlags usage,
+    uint32_t mipLevels)
 {
     vk::ImageCreateInfo imageInfo{};
     imageInfo.arrayLayers = layerCount;
-    imageInfo.extent = vk::Extent3D{extent.width, extent.height, 1};
+    imageInfo.extent = vk::Extent3D{
+        extent.width, extent.height, viewType == vk::ImageViewType::e3D ? extent.depth : 1};
     imageInfo.flags = imageCreateFlags(viewType);
     imageInfo.format = format;
     imageInfo.imageType = imageType(viewType);
     imageInfo.initialLayout = vk::ImageLayout::eUndefined;
-    imageInfo.mipLevels = 1;
+    imageInfo.mipLevels = mipLevels;
     imageInfo.samples = vk::SampleCountFlagBits::e1;
     imageInfo.sharingMode = vk::SharingMode::eExclusive;
     imageInfo.tiling = tiling;
@@ -112,7 +115,13 @@ vk::ImageAspectFlags aspectMaskFromFormat(vk::Format format)
     }
 }
 
-vk::ImageView createImageView(vk::Device device, vk::ImageViewType type, vk::Image image, vk::Format format)
+vk::ImageView createImageView(
+    vk::Device device,
+    vk::ImageViewType type,
+    vk::Image image,
+    vk::Format format,
+    uint32_t layerCount,
+    uint32_t mipLevels)
 {
     vk::ImageViewCreateInfo viewInfo;
     viewInfo.image = image;
@@ -120,42 +129,14 @@ vk::ImageView createImageView(vk::Device device, vk::ImageViewType type, vk::Ima
     viewInfo.format = format;
     viewInfo.subresourceRange.aspectMask = aspectMaskFromFormat(format);
     viewInfo.subresourceRange.baseMipLevel = 0;
-    viewInfo.subresourceRange.levelCount = 1;
+    viewInfo.subresourceRange.levelCount = mipLevels;
     viewInfo.subresourceRange.baseArrayLayer = 0;
-    viewInfo.subresourceRange.layerCount = 1;
+    viewInfo.subresourceRange.layerCount = layerCount;
 
     vk::ImageView imageView = device.createImageView(viewInfo, nullptr);
     return imageView;
 }
 
-vk::Sampler createSampler(vk::Device device, vk::SamplerAddressMode addressMode)
-{
-    vk::SamplerCreateInfo samplerInfo{};
-
-    samplerInfo.magFilter = vk::Filter::eLinear;
-    samplerInfo.minFilter = vk::Filter::eLinear;
-
-    samplerInfo.addressModeU = addressMode;
-    samplerInfo.addressModeV = addressMode;
-    samplerInfo.addressModeW = addressMode;
-
-    samplerInfo.anisotropyEnable = true;
-    samplerInfo.maxAnisotropy = 16;
-    samplerInfo.borderColor = vk::BorderColor::eFloatOpaqueWhite;
-    samplerInfo.unnormalizedCoordinates = false;
-
-    samplerInfo.compareEnable = false;
-    samplerInfo.compareOp = vk::CompareOp::eAlways;
-
-    samplerInfo.mipmapMode = vk::SamplerMipmapMode::eLinear;
-    samplerInfo.mipLodBias = 0.0f;
-    samplerInfo.minLod = 0.0f;
-    samplerInfo.maxLod = 0.0f;
-
-    vk::Sampler sampler = device.createSampler(samplerInfo);
-    return sampler;
-}
-
 Texture::Texture(
     Device& device,
     vk::ImageViewType type,
@@ -165,22 +146,28 @@ Texture::Texture(
     vk::ImageTiling tiling,
     vk::ImageUsageFlags usage,
     vk::MemoryPropertyFlags memoryProperties,
-    vk::SamplerAddressMode addressMode)
+    vk::SamplerAddressMode addressMode,
+    uint32_t mipLevels)
     : mDevice{device},
       mType{type},
       mLayerCount{layerCount},
       mExtent{extent},
+      mMipLevels{mipLevels},
       mFormat{format},
-      mImage{createImage(mDevice, mType, layerCount, mExtent, mFormat, tiling, usage)},
+      mImage{createImage(mDevice, mType, layerCount, mExtent, mFormat, tiling, usage, mMipLevels)},
       mMemory{allocateAndBindMemory(mDevice, mImage, memoryProperties)},
-      mImageView{createImageView(mDevice, mType, mImage, mFormat)},
-      mSampler{createSampler(device, addressMode)}
+      mImageView{createImageView(mDevice, mType, mImage, mFormat, mLayerCount, mMipLevels)},
+      mSampler{mDevice.samplerCache().sampler(samplerState(addressMode))}
 {
 }
 
+vk::DeviceSize Texture::memorySize() const
+{
+    return static_cast<vk::Device>(mDevice).getImageMemoryRequirements(mImage).size;
+}
+
 Texture::~Texture()
 {
-    static_cast<vk::Device>(mDevice).destroySampler(mSampler);
     static_cast<vk::Device>(mDevice).destroyImageView(mImageView);
     static_cast<vk::Device>(mDevice).freeMemory(mMemory);
     static_cast<vk::Device>(mDevice).destroyImage(mImage);
@@ -201,7 +188,7 @@ void Texture::transitionLayout(
     barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
     barrier.image = mImage;
     barrier.subresourceRange.baseMipLevel = 0;
-    barrier.subresourceRange.levelCount = 1;
+    barrier.subresourceRange.levelCount = mMipLevels;
     barrier.subresourceRange.baseArrayLayer = 0;
     barrier.subresourceRange.layerCount = mLayerCount;
 
@@ -367,6 +354,107 @@ void Texture::transitionLayout(
     }
 }
 
+void Texture::generateMipmaps(vk::CommandBuffer externalCommandBuffer)
+{
+    vk::CommandBuffer commandBuffer = externalCommandBuffer;
+    if (!commandBuffer) {
+        commandBuffer = mDevice.createAndBeginCommandBuffer();
+    }
+
+    vk::ImageMemoryBarrier barrier;
+    barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.image = mImage;
+    barrier.subresourceRange.aspectMask = vk::ImageAspectFlagBits::eColor;
+    barrier.subresourceRange.levelCount = 1;
+    barrier.subresourceRange.baseArrayLayer = 0;
+    barrier.subresourceRange.layerCount = mLayerCount;
+
+    int32_t width = static_cast<int32_t>(mExtent.width);
+    int32_t height = static_cast<int32_t>(mExtent.height);
+
+    for (uint32_t level = 1; level < mMipLevels; level++) {
+        int32_t levelWidth = std::max(width / 2, 1);
+        int32_t levelHeight = std::max(height / 2, 1);
+
+        barrier.subresourceRange.baseMipLevel = level - 1;
+        barrier.oldLayout = vk::ImageLayout::eTransferDstOptimal;
+        barrier.newLayout = vk::ImageLayout::eTransferSrcOptimal;
+        barrier.srcAccessMask = vk::AccessFlagBits::eTransferWrite;
+        barrier.dstAccessMask = vk::AccessFlagBits::eTransferRead;
+        commandBuffer.pipelineBarrier(
+            vk::PipelineStageFlagBits::eTransfer,
+            vk::PipelineStageFlagBits::eTransfer,
+            {},
+            nullptr,
+            nullptr,
+            barrier);
+
+        vk::ImageBlit blit;
+        blit.srcOffsets[0] = vk::Offset3D{0, 0, 0};
+        blit.srcOffsets[1] = vk::Offset3D{width, height, 1};
+        blit.srcSubresource.aspectMask = vk::ImageAspectFlagBits::eColor;
+        blit.srcSubresource.mipLevel = level - 1;
+        blit.srcSubresource.baseArrayLayer = 0;
+        blit.srcSubresource.layerCount = mLayerCount;
+        blit.dstOffsets[0] = vk::Offset3D{0, 0, 0};
+        blit.dstOffsets[1] = vk::Offset3D{levelWidth, levelHeight, 1};
+        blit.dstSubresource.aspectMask = vk::ImageAspectFlagBits::eColor;
+        blit.dstSubresource.mipLevel = level;
+        blit.dstSubresource.baseArrayLayer = 0;
+        blit.dstSubresource.layerCount = mLayerCount;
+
+        commandBuffer.blitImage(
+            mImage,
+            vk::ImageLayout::eTransferSrcOptimal,
+            mImage,
+            vk::ImageLayout::eTransferDstOptimal,
+            blit,
+            vk::Filter::eLinear);
+
+        barrier.oldLayout = vk::ImageLayout::eTransferSrcOptimal;
+        barrier.newLayout = vk::ImageLayout::eShaderReadOnlyOptimal;
+        barrier.srcAccessMask = vk::AccessFlagBits::eTransferRead;
+        barrier.dstAccessMask = vk::AccessFlagBits::eShaderRead;
+        commandBuffer.pipelineBarrier(
+            vk::PipelineStageFlagBits::eTransfer,
+            vk::PipelineStageFlagBits::eFragmentShader,
+            {},
+            nullptr,
+            nullptr,
+            barrier);
+
+        width = levelWidth;
+        height = levelHeight;
+    }
+
+    barrier.subresourceRange.baseMipLevel = mMipLevels - 1;
+    barrier.oldLayout = vk::ImageLayout::eTransferDstOptimal;
+    barrier.newLayout = vk::ImageLayout::eShaderReadOnlyOptimal;
+    barrier.srcAccessMask = vk::AccessFlagBits::eTransferWrite;
+    barrier.dstAccessMask = vk::AccessFlagBits::eShaderRead;
+    commandBuffer.pipelineBarrier(
+        vk::PipelineStageFlagBits::eTransfer,
+        vk::PipelineStageFlagBits::eFragmentShader,
+        {},
+        nullptr,
+        nullptr,
+        barrier);
+
+    if (!externalCommandBuffer) {
+        mDevice.flushAndFreeCommandBuffer(commandBuffer);
+    }
+}
+
+bool supportsLinearBlit(Device& device, vk::Format format)
+{
+    const vk::FormatFeatureFlags features = vk::FormatFeatureFlagBits::eBlitSrc |
+        vk::FormatFeatureFlagBits::eBlitDst | vk::FormatFeatureFlagBits::eSampledImageFilterLinear;
+
+    vk::FormatProperties properties = device.physicalDevice().getFormatProperties(format);
+    return (properties.optimalTilingFeatures & features) == features;
+}
+
 //Texture createTextureFromFile(Device& device, std::string filename, vk::SamplerAddressMode addressMode)
 //{
 //    const int bytesPerPixel = 4;
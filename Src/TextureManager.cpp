@@ -4,126 +4,1103 @@
 
 #include "../Include/TextureManager.h"
 #include "../Include/Buffer.h"
+#include "../Include/CookedTexture.h"
+#include "../Include/DdsFile.h"
+#include "../Include/Device.h"
+#include <algorithm>
+#include <iostream>
+#include <limits>
 #include <stb_image.h>
 
-TextureContainer::TextureContainer(std::string filename, Texture texture)
-    : filename{filename}, texture{std::move(texture)}
+// Number of frames a released texture is kept alive, covering every frame that may still be in
+// flight on the GPU when the last reference is dropped.
+const uint64_t textureDestroyDelay = 3;
+
+// Bytes of streamed texture data uploaded per frame. The first stage in priority order is always
+// uploaded so a single large texture cannot stall streaming.
+const vk::DeviceSize streamingUploadBudget = 16 * 1024 * 1024;
+
+// Streamed DDS files with mip chains first upload the levels at or below this size.
+const uint32_t streamingTailSize = 64;
+
+// Textures larger than this on either axis are not worth packing.
+const uint32_t packedTextureMaxSize = 256;
+
+static Texture createPlaceholderTexture(Device& device)
+{
+    const uint32_t white = 0xffffffff;
+
+    Buffer stagingBuffer(
+        device,
+        sizeof(white),
+        vk::BufferUsageFlagBits::eTransferSrc,
+        vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCoherent);
+
+    void* data = stagingBuffer.mapMemory();
+    memcpy(data, &white, sizeof(white));
+    stagingBuffer.unmapMemory();
+
+    Texture texture{
+        device,
+        vk::ImageViewType::e2D,
+        1,
+        vk::Extent3D(1, 1, 1),
+        vk::Format::eR8G8B8A8Unorm,
+        vk::ImageTiling::eOptimal,
+        vk::ImageUsageFlagBits::eTransferDst | vk::ImageUsageFlagBits::eSampled,
+        vk::MemoryPropertyFlagBits::eDeviceLocal,
+        vk::SamplerAddressMode::eRepeat};
+
+    texture.transitionLayout(vk::ImageLayout::eUndefined, vk::ImageLayout::eTransferDstOptimal);
+    stagingBuffer.copyToTexture(texture, 0);
+    texture.transitionLayout(
+        vk::ImageLayout::eTransferDstOptimal, vk::ImageLayout::eShaderReadOnlyOptimal);
+    return texture;
+}
+
+TextureManager::TextureManager(Device& device)
+    : mDevice{device},
+      mFrame{0},
+      mPlaceholder{createPlaceholderTexture(mDevice)},
+      mMemoryBudget{std::numeric_limits<vk::DeviceSize>::max()}
+{
+}
+
+TextureManager::~TextureManager()
+{
+    mPackedTextures.clear();
+    mStreamRequests.clear();
+    mPendingTextures.clear();
+    mSlots.clear();
+}
+
+TextureSlot& TextureManager::slot(TextureHandle handle)
+{
+    if (handle.index >= mSlots.size() || mSlots[handle.index].generation != handle.generation) {
+        throw std::runtime_error("Stale texture handle!");
+    }
+    return mSlots[handle.index];
+}
+
+TextureHandle TextureManager::allocateSlot(
+    const std::string& filename, vk::SamplerAddressMode addressMode)
+{
+    uint32_t index = 0;
+    if (!mFreeSlots.empty()) {
+        index = mFreeSlots.back();
+        mFreeSlots.pop_back();
+    } else {
+        index = static_cast<uint32_t>(mSlots.size());
+        mSlots.emplace_back();
+        mSlots.back().generation = 1;
+    }
+
+    TextureSlot& slot = mSlots[index];
+    slot.filename = filename;
+    slot.refCount = 1;
+    slot.revision = 0;
+    slot.addressMode = addressMode;
+    slot.evictable = false;
+    slot.evicted = false;
+    slot.lastUsedFrame = mFrame;
+    slot.memorySize = 0;
+    mSlotsBySource[{filename, addressMode}] = index;
+    return {index, slot.generation};
+}
+
+TextureHandle TextureManager::insertTexture(
+    const std::string& filename, vk::SamplerAddressMode addressMode, Texture texture)
+{
+    TextureHandle handle = allocateSlot(filename, addressMode);
+    TextureSlot& slot = mSlots[handle.index];
+    slot.memorySize = texture.memorySize();
+    slot.texture = std::make_unique<Texture>(std::move(texture));
+    return handle;
+}
+
+Texture& TextureManager::texture(TextureHandle handle)
 {
+    TextureSlot& slot = this->slot(handle);
+    return slot.texture ? *slot.texture : mPlaceholder;
 }
 
-TextureManager::TextureManager(Device& device) : mDevice{device}
+uint32_t TextureManager::revision(TextureHandle handle)
 {
+    return slot(handle).revision;
+}
+
+void TextureManager::acquire(TextureHandle handle)
+{
+    slot(handle).refCount++;
+}
+
+void TextureManager::release(TextureHandle handle)
+{
+    TextureSlot& slot = this->slot(handle);
+    if (--slot.refCount > 0) {
+        return;
+    }
+
+    mPendingTextures.push_back({std::move(slot.texture), mFrame});
+    mSlotsBySource.erase({slot.filename, slot.addressMode});
+    slot.filename.clear();
+
+    // Textures packed into a released array are streamed on their own again if loaded later.
+    for (auto it = mPackedTextures.begin(); it != mPackedTextures.end();) {
+        if (it->second.texture.index == handle.index) {
+            it = mPackedTextures.erase(it);
+        } else {
+            ++it;
+        }
+    }
+    slot.memorySize = 0;
+
+    // Generation zero is reserved for the null handle.
+    if (++slot.generation == 0) {
+        slot.generation = 1;
+    }
+    mFreeSlots.push_back(handle.index);
+}
+
+void TextureManager::markUsed(TextureHandle handle)
+{
+    TextureSlot& slot = this->slot(handle);
+    slot.lastUsedFrame = mFrame;
+
+    if (slot.evicted) {
+        slot.evicted = false;
+        requestStream(handle, 0.0f);
+    }
+}
+
+vk::DeviceSize TextureManager::residentMemory() const
+{
+    vk::DeviceSize size = 0;
+    for (auto& slot : mSlots) {
+        size += slot.memorySize;
+    }
+    return size;
+}
+
+void TextureManager::enforceMemoryBudget()
+{
+    vk::DeviceSize resident = residentMemory();
+
+    while (resident > mMemoryBudget) {
+        TextureSlot* victim = nullptr;
+        for (uint32_t i = 0; i < mSlots.size(); i++) {
+            TextureSlot& slot = mSlots[i];
+            if (!slot.texture || !slot.evictable || slot.lastUsedFrame + 1 >= mFrame ||
+                isStreaming(i)) {
+                continue;
+            }
+            if (!victim || slot.lastUsedFrame < victim->lastUsedFrame) {
+                victim = &slot;
+            }
+        }
+
+        // Everything left was used in the last frame, thrashing would not help.
+        if (!victim) {
+            break;
+        }
+
+        resident -= victim->memorySize;
+        mPendingTextures.push_back({std::move(victim->texture), mFrame});
+        victim->memorySize = 0;
+        victim->evicted = true;
+        victim->revision++;
+    }
+}
+
+void TextureManager::collectGarbage()
+{
+    enforceMemoryBudget();
+
+    mFrame++;
+    mPendingTextures.erase(
+        std::remove_if(
+            mPendingTextures.begin(),
+            mPendingTextures.end(),
+            [this](const PendingTexture& pending) {
+                return mFrame - pending.frame >= textureDestroyDelay;
+            }),
+        mPendingTextures.end());
 }
 
 Texture& TextureManager::createTextureFromFile(
     std::string filename, vk::SamplerAddressMode addressMode)
 {
-    if (filename.empty()) {
-        throw std::runtime_error("Failed to load texture image!");
+    return texture(loadTexture(filename, addressMode));
+}
+
+Texture& TextureManager::createCubeTextureFromFile(std::array<std::string, 6> filenames)
+{
+    return texture(loadCubeTexture(filenames));
+}
+
+static bool hasExtension(const std::string& filename, const std::string& extension)
+{
+    if (filename.size() < extension.size()) {
+        return false;
+    }
+    return std::equal(extension.rbegin(), extension.rend(), filename.rbegin(), [](char a, char b) {
+        return tolower(a) == tolower(b);
+    });
+}
+
+static bool supportsSampling(Device& device, vk::Format format)
+{
+    vk::FormatProperties properties = device.physicalDevice().getFormatProperties(format);
+    return static_cast<bool>(
+        properties.optimalTilingFeatures & vk::FormatFeatureFlagBits::eSampledImage);
+}
+
+static vk::ImageViewType ddsViewType(const DdsImage& image)
+{
+    if (image.cube && image.layerCount == 6) {
+        return vk::ImageViewType::eCube;
+    } else if (image.cube) {
+        return vk::ImageViewType::eCubeArray;
+    } else if (image.layerCount > 1) {
+        return vk::ImageViewType::e2DArray;
+    } else {
+        return vk::ImageViewType::e2D;
+    }
+}
+
+// Keeps the blocks of a DDS file from firstLevel down as they are, or decodes them to RGBA8 when
+// the device cannot sample the compressed format.
+static TextureData ddsTextureData(Device& device, const DdsImage& image, uint32_t firstLevel)
+{
+    TextureData texture{};
+    texture.viewType = ddsViewType(image);
+    texture.format = image.format;
+    texture.extent = image.levels[firstLevel].extent;
+    texture.layerCount = image.layerCount;
+    texture.mipLevels = image.mipLevels - firstLevel;
+    texture.generateMipmaps = false;
+
+    bool decompress = isBlockCompressed(image.format) && !supportsSampling(device, image.format);
+    if (decompress) {
+        texture.format = decompressedFormat(image.format);
     }
 
-    for (auto& texture : mTextures) {
-        if (texture.filename == filename) {
-            return texture.texture;
+    for (uint32_t layer = 0; layer < image.layerCount; layer++) {
+        for (uint32_t level = firstLevel; level < image.mipLevels; level++) {
+            const DdsLevel& ddsLevel = image.levels[layer * image.mipLevels + level];
+            const char* levelData = image.data.data() + ddsLevel.offset;
+
+            vk::BufferImageCopy region{};
+            region.bufferOffset = texture.data.size();
+            region.imageSubresource.aspectMask = vk::ImageAspectFlagBits::eColor;
+            region.imageSubresource.mipLevel = level - firstLevel;
+            region.imageSubresource.baseArrayLayer = layer;
+            region.imageSubresource.layerCount = 1;
+            region.imageExtent = ddsLevel.extent;
+            texture.regions.push_back(region);
+
+            if (decompress) {
+                auto pixels = decompressBlocks(image.format, levelData, ddsLevel.extent);
+                texture.data.insert(texture.data.end(), pixels.begin(), pixels.end());
+            } else {
+                texture.data.insert(texture.data.end(), levelData, levelData + ddsLevel.size);
+            }
         }
     }
 
-    const int bytesPerPixel = 4;
+    return texture;
+}
+
+static TextureData decodeDdsTexture(Device& device, const std::string& filename)
+{
+    return ddsTextureData(device, readDdsFile(filename), 0);
+}
+
+// With cpuMipmaps the whole chain is box filtered here, otherwise only the base level is kept and
+// the mips are blitted on the GPU after upload.
+static TextureData decodeImageTexture(const std::string& filename, bool cpuMipmaps)
+{
     int width = 0;
     int height = 0;
     int channelCount = 0;
 
     stbi_uc* pixels = stbi_load(filename.data(), &width, &height, &channelCount, STBI_rgb_alpha);
     if (!pixels) {
-        throw std::runtime_error("Failed to load texture image!");
+        throw std::runtime_error("Failed to load texture image " + filename);
+    }
+
+    TextureData texture{};
+    texture.viewType = vk::ImageViewType::e2D;
+    texture.format = vk::Format::eR8G8B8A8Unorm;
+    texture.extent = vk::Extent3D(width, height, 1);
+    texture.layerCount = 1;
+    texture.mipLevels = mipLevelCount(texture.extent);
+    texture.generateMipmaps = !cpuMipmaps;
+
+    uint32_t uploadedLevels = cpuMipmaps ? texture.mipLevels : 1;
+    texture.data = createMipChain(pixels, texture.extent, uploadedLevels, texture.regions);
+    stbi_image_free(pixels);
+
+    return texture;
+}
+
+// Cooked files are already in their final layout, so the texels stay in the mapping and are
+// copied from there straight into the staging buffer. Only a compressed format the device cannot
+// sample needs a CPU pass.
+static TextureData decodeCookedTexture(Device& device, const std::string& filename)
+{
+    CookedTexture cooked = readCookedTexture(filename);
+
+    TextureData texture{};
+    texture.viewType = cooked.layout.viewType;
+    texture.format = cooked.layout.format;
+    texture.extent = cooked.layout.extent;
+    texture.layerCount = cooked.layout.layerCount;
+    texture.mipLevels = cooked.layout.mipLevels;
+    texture.generateMipmaps = false;
+
+    if (!isBlockCompressed(texture.format) || supportsSampling(device, texture.format)) {
+        texture.regions = cooked.layout.regions;
+        texture.cooked = std::move(cooked);
+        return texture;
+    }
+
+    texture.format = decompressedFormat(cooked.layout.format);
+    for (auto region : cooked.layout.regions) {
+        const char* blocks = reinterpret_cast<const char*>(cooked.data) + region.bufferOffset;
+        auto pixels = decompressBlocks(cooked.layout.format, blocks, region.imageExtent);
+        region.bufferOffset = texture.data.size();
+        texture.regions.push_back(region);
+        texture.data.insert(texture.data.end(), pixels.begin(), pixels.end());
+    }
+    return texture;
+}
+
+static const uint8_t* texelData(const TextureData& texture)
+{
+    return texture.cooked.file ? texture.cooked.data : texture.data.data();
+}
+
+static size_t texelSize(const TextureData& texture)
+{
+    return texture.cooked.file ? texture.cooked.size : texture.data.size();
+}
+
+// Runs on the device thread pool, so it must not touch the texture registry.
+static TextureData decodeTexture(Device& device, const std::string& filename, bool linearBlit)
+{
+    if (hasExtension(filename, ".ctex")) {
+        return decodeCookedTexture(device, filename);
+    } else if (hasExtension(filename, ".dds")) {
+        return decodeDdsTexture(device, filename);
+    } else {
+        return decodeImageTexture(filename, !linearBlit);
     }
+}
+
+// Copies every decoded texture through one staging buffer and records all copies, transitions
+// and mip blits into a single command buffer.
+std::vector<Texture> TextureManager::uploadTextures(std::vector<TextureData>& textures)
+{
+    // Keeps every texture's data aligned for both RGBA8 texels and 16 byte compressed blocks.
+    const vk::DeviceSize alignment = 16;
 
-    vk::DeviceSize imageSize = width * height * bytesPerPixel;
+    std::vector<vk::DeviceSize> offsets{};
+    vk::DeviceSize size = 0;
+    for (auto& texture : textures) {
+        size = (size + alignment - 1) / alignment * alignment;
+        offsets.push_back(size);
+        size += texelSize(texture);
+    }
 
     Buffer stagingBuffer(
         mDevice,
-        imageSize,
+        size,
         vk::BufferUsageFlagBits::eTransferSrc,
         vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCoherent);
 
-    void* data = stagingBuffer.mapMemory();
-    memcpy(data, pixels, imageSize);
+    char* data = static_cast<char*>(stagingBuffer.mapMemory());
+    for (size_t i = 0; i < textures.size(); i++) {
+        memcpy(data + offsets[i], texelData(textures[i]), texelSize(textures[i]));
+    }
     stagingBuffer.unmapMemory();
-    stbi_image_free(pixels);
 
-    Texture texture{
-        mDevice,
-        vk::ImageViewType::e2D,
-        1,
-        vk::Extent3D(width, height, 1),
-        vk::Format::eR8G8B8A8Unorm,
-        vk::ImageTiling::eOptimal,
-        vk::ImageUsageFlagBits::eTransferDst | vk::ImageUsageFlagBits::eTransferSrc |
-            vk::ImageUsageFlagBits::eSampled,
-        vk::MemoryPropertyFlagBits::eDeviceLocal,
-        addressMode};
+    std::vector<Texture> uploaded{};
+    uploaded.reserve(textures.size());
 
-    texture.transitionLayout(vk::ImageLayout::eUndefined, vk::ImageLayout::eTransferDstOptimal);
-    stagingBuffer.copyToTexture(texture, 0);
-    texture.transitionLayout(
-        vk::ImageLayout::eTransferDstOptimal, vk::ImageLayout::eShaderReadOnlyOptimal);
+    vk::CommandBuffer commandBuffer = mDevice.createAndBeginCommandBuffer();
 
-    return mTextures.emplace_back(filename, std::move(texture)).texture;
+    for (size_t i = 0; i < textures.size(); i++) {
+        TextureData& data = textures[i];
+        Texture& texture = uploaded.emplace_back(
+            mDevice,
+            data.viewType,
+            data.layerCount,
+            data.extent,
+            data.format,
+            vk::ImageTiling::eOptimal,
+            vk::ImageUsageFlagBits::eTransferDst | vk::ImageUsageFlagBits::eTransferSrc |
+                vk::ImageUsageFlagBits::eSampled,
+            vk::MemoryPropertyFlagBits::eDeviceLocal,
+            data.addressMode,
+            data.mipLevels);
+
+        for (auto& region : data.regions) {
+            region.bufferOffset += offsets[i];
+        }
+
+        texture.transitionLayout(
+            vk::ImageLayout::eUndefined, vk::ImageLayout::eTransferDstOptimal, commandBuffer);
+        commandBuffer.copyBufferToImage(
+            stagingBuffer, texture.image(), vk::ImageLayout::eTransferDstOptimal, data.regions);
+
+        if (data.generateMipmaps && data.mipLevels > 1) {
+            texture.generateMipmaps(commandBuffer);
+        } else {
+            texture.transitionLayout(
+                vk::ImageLayout::eTransferDstOptimal,
+                vk::ImageLayout::eShaderReadOnlyOptimal,
+                commandBuffer);
+        }
+    }
+
+    mDevice.flushAndFreeCommandBuffer(commandBuffer);
+    return uploaded;
 }
 
-Texture& TextureManager::createCubeTextureFromFile(std::array<std::string, 6> filenames)
+TextureHandle TextureManager::loadTexture(
+    const std::string& filename, vk::SamplerAddressMode addressMode)
 {
-    std::vector<Buffer> stagingBuffers{};
-    std::string combinedFilenames;
-    int width = 0;
-    int height = 0;
+    return loadTextures({filename}, addressMode).front();
+}
 
-    for (int face = 0; face < 6; face++) {
-        const int bytesPerPixel = 4;
-        int channelCount = 0;
+std::vector<TextureHandle> TextureManager::loadTextures(
+    const std::vector<std::string>& filenames, vk::SamplerAddressMode addressMode)
+{
+    std::vector<TextureHandle> handles(filenames.size());
+    std::vector<std::string> pendingFilenames{};
+    std::vector<std::future<TextureData>> pendingTextures{};
+
+    bool linearBlit = supportsLinearBlit(mDevice, vk::Format::eR8G8B8A8Unorm);
 
-        stbi_uc* pixels =
-            stbi_load(filenames[face].data(), &width, &height, &channelCount, STBI_rgb_alpha);
-        if (!pixels) {
+    for (size_t i = 0; i < filenames.size(); i++) {
+        if (filenames[i].empty()) {
             throw std::runtime_error("Failed to load texture image!");
         }
 
-        vk::DeviceSize imageSize = width * height * bytesPerPixel;
+        auto it = mSlotsBySource.find({filenames[i], addressMode});
+        if (it != mSlotsBySource.end()) {
+            handles[i] = {it->second, mSlots[it->second].generation};
+            acquire(handles[i]);
+            try {
+                makeResident(handles[i]);
+            } catch (...) {
+                for (auto& handle : handles) {
+                    if (handle.valid()) {
+                        release(handle);
+                    }
+                }
+                throw;
+            }
+        } else if (
+            std::find(pendingFilenames.begin(), pendingFilenames.end(), filenames[i]) ==
+            pendingFilenames.end()) {
+            pendingFilenames.push_back(filenames[i]);
+            pendingTextures.push_back(mDevice.threadPool().submit(
+                [&device = mDevice, filename = filenames[i], linearBlit]() {
+                    return decodeTexture(device, filename, linearBlit);
+                }));
+        }
+    }
 
-        stagingBuffers.emplace_back(
-            mDevice,
-            imageSize,
-            vk::BufferUsageFlagBits::eTransferSrc,
-            vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCoherent);
+    if (pendingTextures.empty()) {
+        return handles;
+    }
+
+    // Wait for every decode before rethrowing so no job outlives the batch.
+    std::vector<TextureData> decoded{};
+    std::exception_ptr error{};
+    for (auto& pendingTexture : pendingTextures) {
+        try {
+            decoded.push_back(pendingTexture.get());
+            decoded.back().addressMode = addressMode;
+        } catch (...) {
+            error = std::current_exception();
+        }
+    }
+    if (error) {
+        for (size_t i = 0; i < filenames.size(); i++) {
+            if (handles[i].valid()) {
+                release(handles[i]);
+            }
+        }
+        std::rethrow_exception(error);
+    }
 
-        Buffer& stagingBuffer = stagingBuffers.back();
+    std::vector<Texture> uploaded = uploadTextures(decoded);
+    for (size_t i = 0; i < uploaded.size(); i++) {
+        insertTexture(pendingFilenames[i], addressMode, std::move(uploaded[i]));
+    }
 
-        void* data = stagingBuffer.mapMemory();
-        memcpy(data, pixels, imageSize);
-        stagingBuffer.unmapMemory();
-        stbi_image_free(pixels);
+    // Each newly inserted texture already holds the reference for its first request.
+    std::vector<bool> claimed(pendingFilenames.size(), false);
+    for (size_t i = 0; i < filenames.size(); i++) {
+        if (handles[i].valid()) {
+            continue;
+        }
 
-        combinedFilenames += filenames[face];
+        size_t pending =
+            std::find(pendingFilenames.begin(), pendingFilenames.end(), filenames[i]) -
+            pendingFilenames.begin();
+        uint32_t index = mSlotsBySource[{filenames[i], addressMode}];
+        handles[i] = {index, mSlots[index].generation};
+        if (claimed[pending]) {
+            acquire(handles[i]);
+        }
+        claimed[pending] = true;
     }
 
-    Texture texture{
-        mDevice,
-        vk::ImageViewType::eCube,
-        6,
-        vk::Extent3D(width, height, 1),
-        vk::Format::eR8G8B8A8Unorm,
-        vk::ImageTiling::eOptimal,
-        vk::ImageUsageFlagBits::eTransferDst | vk::ImageUsageFlagBits::eTransferSrc |
-            vk::ImageUsageFlagBits::eSampled,
-        vk::MemoryPropertyFlagBits::eDeviceLocal,
-        vk::SamplerAddressMode::eClampToEdge};
+    return handles;
+}
 
-    texture.transitionLayout(vk::ImageLayout::eUndefined, vk::ImageLayout::eTransferDstOptimal);
-    for (int face = 0; face < 6; face++) {
-        stagingBuffers[face].copyToTexture(texture, face);
+// Decodes a file for streaming. DDS files with a mip chain get an extra first stage holding only
+// the small tail mips, which uploads almost immediately.
+static std::vector<TextureData> decodeStreamingStages(
+    Device& device, const std::string& filename, bool linearBlit)
+{
+    std::vector<TextureData> stages{};
+
+    if (hasExtension(filename, ".dds")) {
+        DdsImage image = readDdsFile(filename);
+        uint32_t tailLevel = 0;
+        while (tailLevel + 1 < image.mipLevels &&
+               std::max(image.levels[tailLevel].extent.width, image.levels[tailLevel].extent.height) >
+                   streamingTailSize) {
+            tailLevel++;
+        }
+        if (tailLevel > 0) {
+            stages.push_back(ddsTextureData(device, image, tailLevel));
+        }
+        stages.push_back(ddsTextureData(device, image, 0));
+    } else {
+        stages.push_back(decodeTexture(device, filename, linearBlit));
     }
-    texture.transitionLayout(
-        vk::ImageLayout::eTransferDstOptimal, vk::ImageLayout::eShaderReadOnlyOptimal);
 
-    return mTextures.emplace_back(combinedFilenames, std::move(texture)).texture;
+    return stages;
+}
+
+TextureHandle TextureManager::streamTexture(
+    const std::string& filename, vk::SamplerAddressMode addressMode, float priority)
+{
+    if (filename.empty()) {
+        throw std::runtime_error("Failed to load texture image!");
+    }
+
+    auto it = mSlotsBySource.find({filename, addressMode});
+    if (it != mSlotsBySource.end()) {
+        TextureHandle handle{it->second, mSlots[it->second].generation};
+        acquire(handle);
+        setStreamingPriority(handle, priority);
+        return handle;
+    }
+
+    TextureHandle handle = allocateSlot(filename, addressMode);
+    mSlots[handle.index].evictable = true;
+    requestStream(handle, priority);
+    return handle;
+}
+
+// The source file doubles as the backing store for evicted textures, so streaming a texture back
+// in is the same as streaming it the first time.
+void TextureManager::requestStream(TextureHandle handle, float priority)
+{
+    const TextureSlot& slot = mSlots[handle.index];
+    bool linearBlit = supportsLinearBlit(mDevice, vk::Format::eR8G8B8A8Unorm);
+
+    StreamRequest request{};
+    request.index = handle.index;
+    request.generation = handle.generation;
+    request.priority = priority;
+    request.nextStage = 0;
+    request.decoded = mDevice.threadPool().submit(
+        [&device = mDevice, filename = slot.filename, addressMode = slot.addressMode, linearBlit]() {
+            auto stages = decodeStreamingStages(device, filename, linearBlit);
+            for (auto& stage : stages) {
+                stage.addressMode = addressMode;
+            }
+            return stages;
+        });
+    mStreamRequests.push_back(std::move(request));
+}
+
+bool TextureManager::isStreaming(uint32_t index) const
+{
+    return std::any_of(
+        mStreamRequests.begin(), mStreamRequests.end(), [this, index](const StreamRequest& request) {
+            return request.index == index && request.generation == mSlots[index].generation;
+        });
+}
+
+void TextureManager::setStreamingPriority(TextureHandle handle, float priority)
+{
+    for (auto& request : mStreamRequests) {
+        if (request.index == handle.index && request.generation == handle.generation) {
+            request.priority = priority;
+        }
+    }
+}
+
+void TextureManager::installStage(StreamRequest& request, Texture texture)
+{
+    TextureSlot& slot = mSlots[request.index];
+
+    // The texture was released while it was still streaming.
+    if (slot.generation != request.generation) {
+        mPendingTextures.push_back({std::make_unique<Texture>(std::move(texture)), mFrame});
+        return;
+    }
+
+    if (slot.texture) {
+        mPendingTextures.push_back({std::move(slot.texture), mFrame});
+    }
+    slot.memorySize = texture.memorySize();
+    slot.texture = std::make_unique<Texture>(std::move(texture));
+    slot.evicted = false;
+    slot.revision++;
+}
+
+// Synchronously loaded textures are documented to stay resident, so a slot shared with a streamed
+// texture stops being evictable and is loaded now if it was evicted or never streamed in.
+void TextureManager::makeResident(TextureHandle handle)
+{
+    TextureSlot& slot = mSlots[handle.index];
+    slot.evictable = false;
+    finishStreaming(handle.index);
+
+    if (!slot.texture) {
+        requestStream(handle, 0.0f);
+        finishStreaming(handle.index);
+    }
+}
+
+void TextureManager::finishStreaming(uint32_t index)
+{
+    auto request = std::find_if(
+        mStreamRequests.begin(), mStreamRequests.end(), [this, index](const StreamRequest& request) {
+            return request.index == index && request.generation == mSlots[index].generation;
+        });
+    if (request == mStreamRequests.end()) {
+        return;
+    }
+
+    if (request->decoded.valid()) {
+        request->stages = request->decoded.get();
+    }
+    if (request->nextStage < request->stages.size()) {
+        std::vector<TextureData> uploads{};
+        uploads.push_back(std::move(request->stages.back()));
+        installStage(*request, std::move(uploadTextures(uploads).front()));
+    }
+    mStreamRequests.erase(request);
+}
+
+void TextureManager::updateStreaming()
+{
+    for (auto& request : mStreamRequests) {
+        if (!request.decoded.valid() ||
+            request.decoded.wait_for(std::chrono::seconds(0)) != std::future_status::ready) {
+            continue;
+        }
+        try {
+            request.stages = request.decoded.get();
+        } catch (const std::exception& e) {
+            std::cout << "Texture streaming failed: " << e.what() << "\n";
+        }
+    }
+
+    std::stable_sort(
+        mStreamRequests.begin(),
+        mStreamRequests.end(),
+        [](const StreamRequest& a, const StreamRequest& b) { return a.priority > b.priority; });
+
+    std::vector<TextureData> uploads{};
+    std::vector<StreamRequest*> owners{};
+    vk::DeviceSize uploadSize = 0;
+
+    for (auto& request : mStreamRequests) {
+        if (request.nextStage >= request.stages.size() ||
+            mSlots[request.index].generation != request.generation) {
+            continue;
+        }
+
+        vk::DeviceSize size = texelSize(request.stages[request.nextStage]);
+        if (!uploads.empty() && uploadSize + size > streamingUploadBudget) {
+            break;
+        }
+
+        uploads.push_back(std::move(request.stages[request.nextStage]));
+        owners.push_back(&request);
+        request.nextStage++;
+        uploadSize += size;
+    }
+
+    if (!uploads.empty()) {
+        std::vector<Texture> uploaded = uploadTextures(uploads);
+        for (size_t i = 0; i < uploaded.size(); i++) {
+            installStage(*owners[i], std::move(uploaded[i]));
+        }
+    }
+
+    mStreamRequests.erase(
+        std::remove_if(
+            mStreamRequests.begin(),
+            mStreamRequests.end(),
+            [this](const StreamRequest& request) {
+                bool stale = mSlots[request.index].generation != request.generation;
+                bool done = !request.decoded.valid() && request.nextStage >= request.stages.size();
+                return stale || done;
+            }),
+        mStreamRequests.end());
+}
+
+// Levels every texture of the array can provide.
+static uint32_t arrayLevelCount(
+    const std::vector<TextureData>& textures, const std::vector<size_t>& members)
+{
+    uint32_t levelCount = std::numeric_limits<uint32_t>::max();
+    for (size_t member : members) {
+        levelCount = std::min(levelCount, textures[member].mipLevels);
+    }
+    return levelCount;
+}
+
+// Side of the square layer a packed texture is padded to. Rounding up to a power of two lets
+// textures of similar size share an array while leaving at most three quarters of a layer unused.
+static uint32_t packedLayerSize(const vk::Extent3D& extent)
+{
+    uint32_t size = 1;
+    while (size < std::max(extent.width, extent.height)) {
+        size *= 2;
+    }
+    return size;
+}
+
+static bool isPackableTexture(
+    vk::ImageViewType viewType, uint32_t layerCount, const vk::Extent3D& extent)
+{
+    return viewType == vk::ImageViewType::e2D && layerCount == 1 && extent.depth == 1 &&
+        std::max(extent.width, extent.height) <= packedTextureMaxSize;
+}
+
+// Copies a tightly packed level into the corner of its layer level and fills the rest of the
+// layer by repeating the last column and row, so filtering across the texture's edge clamps to
+// it instead of reading undefined texels. Compressed levels are padded in whole blocks.
+static void padLevel(
+    const uint8_t* texels,
+    vk::Format format,
+    const vk::Extent3D& extent,
+    const vk::Extent3D& layerExtent,
+    std::vector<uint8_t>& data)
+{
+    uint32_t blockDim = isBlockCompressed(format) ? 4 : 1;
+    size_t unitSize = levelSize(format, vk::Extent3D{1, 1, 1});
+    uint32_t columns = (extent.width + blockDim - 1) / blockDim;
+    uint32_t rows = (extent.height + blockDim - 1) / blockDim;
+    uint32_t layerColumns = (layerExtent.width + blockDim - 1) / blockDim;
+    uint32_t layerRows = (layerExtent.height + blockDim - 1) / blockDim;
+
+    for (uint32_t row = 0; row < layerRows; row++) {
+        const uint8_t* source = texels + std::min(row, rows - 1) * columns * unitSize;
+        data.insert(data.end(), source, source + columns * unitSize);
+
+        const uint8_t* last = source + (columns - 1) * unitSize;
+        for (uint32_t column = columns; column < layerColumns; column++) {
+            data.insert(data.end(), last, last + unitSize);
+        }
+    }
+}
+
+std::vector<PackedTexture> TextureManager::packTextures(
+    const std::vector<std::string>& filenames, vk::SamplerAddressMode addressMode)
+{
+    std::vector<std::string> pendingFilenames{};
+    std::vector<std::future<TextureData>> pendingTextures{};
+
+    for (auto& filename : filenames) {
+        if (mPackedTextures.count(filename) ||
+            std::find(pendingFilenames.begin(), pendingFilenames.end(), filename) !=
+                pendingFilenames.end()) {
+            continue;
+        }
+        pendingFilenames.push_back(filename);
+        pendingTextures.push_back(mDevice.threadPool().submit([&device = mDevice, filename]() {
+            return decodeTexture(device, filename, false);
+        }));
+    }
+
+    std::vector<TextureData> decoded{};
+    std::exception_ptr error{};
+    for (auto& pendingTexture : pendingTextures) {
+        try {
+            decoded.push_back(pendingTexture.get());
+        } catch (...) {
+            error = std::current_exception();
+        }
+    }
+    if (error) {
+        std::rethrow_exception(error);
+    }
+
+    // Each texture gets its own layer of an array shared with the textures of the same format
+    // and layer size, so filtering and mips never reach a neighbour. Smaller textures are padded
+    // to the layer size and mapped into their corner by the uv transform.
+    std::vector<std::pair<vk::Format, uint32_t>> keys{};
+    std::vector<std::vector<size_t>> groups{};
+    for (size_t i = 0; i < decoded.size(); i++) {
+        const TextureData& texture = decoded[i];
+        if (!isPackableTexture(texture.viewType, texture.layerCount, texture.extent)) {
+            throw std::runtime_error("Texture cannot be packed: " + pendingFilenames[i]);
+        }
+
+        auto key = std::find(
+            keys.begin(),
+            keys.end(),
+            std::make_pair(texture.format, packedLayerSize(texture.extent)));
+        if (key == keys.end()) {
+            keys.emplace_back(texture.format, packedLayerSize(texture.extent));
+            groups.emplace_back();
+            key = keys.end() - 1;
+        }
+        groups[key - keys.begin()].push_back(i);
+    }
+
+    // Every level of every layer is padded on the CPU, so each one uploads with a single region
+    // covering the whole layer level.
+    std::vector<TextureData> arrays{};
+    for (size_t i = 0; i < groups.size(); i++) {
+        std::vector<size_t>& members = groups[i];
+
+        TextureData array{};
+        array.viewType = vk::ImageViewType::e2DArray;
+        array.format = keys[i].first;
+        array.extent = vk::Extent3D{keys[i].second, keys[i].second, 1};
+        array.layerCount = static_cast<uint32_t>(members.size());
+        array.mipLevels = arrayLevelCount(decoded, members);
+        array.generateMipmaps = false;
+        array.addressMode = addressMode;
+
+        for (uint32_t layer = 0; layer < members.size(); layer++) {
+            TextureData& texture = decoded[members[layer]];
+            for (auto& region : texture.regions) {
+                uint32_t level = region.imageSubresource.mipLevel;
+                if (level >= array.mipLevels) {
+                    continue;
+                }
+
+                vk::BufferImageCopy layerRegion = region;
+                layerRegion.bufferOffset = array.data.size();
+                layerRegion.bufferRowLength = 0;
+                layerRegion.bufferImageHeight = 0;
+                layerRegion.imageSubresource.baseArrayLayer = layer;
+                layerRegion.imageOffset = vk::Offset3D{0, 0, 0};
+                layerRegion.imageExtent = vk::Extent3D{
+                    std::max(array.extent.width >> level, 1u),
+                    std::max(array.extent.height >> level, 1u),
+                    1};
+                array.regions.push_back(layerRegion);
+
+                padLevel(
+                    texelData(texture) + region.bufferOffset,
+                    array.format,
+                    region.imageExtent,
+                    layerRegion.imageExtent,
+                    array.data);
+            }
+        }
+
+        arrays.push_back(std::move(array));
+    }
+
+    std::vector<Texture> uploaded{};
+    if (!arrays.empty()) {
+        uploaded = uploadTextures(arrays);
+    }
+    std::vector<TextureHandle> handles{};
+    for (size_t i = 0; i < uploaded.size(); i++) {
+        std::string combinedFilenames;
+        for (size_t member : groups[i]) {
+            combinedFilenames += pendingFilenames[member];
+        }
+        TextureHandle handle =
+            insertTexture(combinedFilenames, addressMode, std::move(uploaded[i]));
+        handles.push_back(handle);
+
+        float layerSize = static_cast<float>(keys[i].second);
+        for (uint32_t layer = 0; layer < groups[i].size(); layer++) {
+            const vk::Extent3D& extent = decoded[groups[i][layer]].extent;
+
+            PackedTexture packed{};
+            packed.texture = handle;
+            packed.uvTransform =
+                glm::vec4{extent.width / layerSize, extent.height / layerSize, 0.0f, 0.0f};
+            packed.layer = layer;
+            mPackedTextures[pendingFilenames[groups[i][layer]]] = packed;
+        }
+    }
+
+    std::vector<PackedTexture> packed{};
+    for (auto& filename : filenames) {
+        packed.push_back(mPackedTextures[filename]);
+        acquire(packed.back().texture);
+    }
+
+    // The registry holds no references of its own, every array now lives as long as the handles
+    // returned here and the ones later acquired through packedTexture.
+    for (auto& handle : handles) {
+        release(handle);
+    }
+    return packed;
+}
+
+bool TextureManager::isPackable(const std::string& filename) const
+{
+    vk::ImageViewType viewType = vk::ImageViewType::e2D;
+    uint32_t layerCount = 1;
+    vk::Extent3D extent{};
+
+    if (hasExtension(filename, ".ctex")) {
+        CookedTexture cooked = readCookedTexture(filename);
+        viewType = cooked.layout.viewType;
+        layerCount = cooked.layout.layerCount;
+        extent = cooked.layout.extent;
+    } else if (hasExtension(filename, ".dds")) {
+        DdsImage image = readDdsHeader(filename);
+        viewType = ddsViewType(image);
+        layerCount = image.layerCount;
+        extent = image.extent;
+    } else {
+        int width = 0;
+        int height = 0;
+        int channelCount = 0;
+        if (!stbi_info(filename.data(), &width, &height, &channelCount)) {
+            return false;
+        }
+        extent = vk::Extent3D(width, height, 1);
+    }
+
+    return isPackableTexture(viewType, layerCount, extent);
+}
+
+const PackedTexture* TextureManager::packedTexture(const std::string& filename) const
+{
+    auto it = mPackedTextures.find(filename);
+    return it != mPackedTextures.end() ? &it->second : nullptr;
+}
+
+// Merges decoded layers into one texture whose regions address each layer, or each depth slice
+// for 3D textures. 3D textures keep only their base level since blits cannot filter slices.
+static TextureData layeredTextureData(std::vector<TextureData>& layers, vk::ImageViewType viewType)
+{
+    for (auto& layer : layers) {
+        if (layer.extent != layers.front().extent || layer.format != layers.front().format ||
+            layer.mipLevels != layers.front().mipLevels || layer.layerCount != 1) {
+            throw std::runtime_error("Texture layers must have the same size and format!");
+        }
+    }
+
+    bool volume = viewType == vk::ImageViewType::e3D;
+    bool cube = viewType == vk::ImageViewType::eCube || viewType == vk::ImageViewType::eCubeArray;
+    if (cube && (layers.size() == 0 || layers.size() % 6 != 0)) {
+        throw std::runtime_error("Cube textures need six layers per cube!");
+    }
+
+    TextureData texture{};
+    texture.viewType = viewType;
+    texture.format = layers.front().format;
+    texture.extent = layers.front().extent;
+    texture.layerCount = volume ? 1 : static_cast<uint32_t>(layers.size());
+    texture.mipLevels = volume ? 1 : layers.front().mipLevels;
+    texture.generateMipmaps = !volume && layers.front().generateMipmaps;
+    if (volume) {
+        texture.extent.depth = static_cast<uint32_t>(layers.size());
+    }
+
+    for (uint32_t i = 0; i < layers.size(); i++) {
+        for (auto region : layers[i].regions) {
+            if (volume && region.imageSubresource.mipLevel > 0) {
+                continue;
+            }
+            region.bufferOffset += texture.data.size();
+            if (volume) {
+                region.imageOffset.z = static_cast<int32_t>(i);
+            } else {
+                region.imageSubresource.baseArrayLayer = i;
+            }
+            texture.regions.push_back(region);
+        }
+
+        const uint8_t* texels = texelData(layers[i]);
+        texture.data.insert(texture.data.end(), texels, texels + texelSize(layers[i]));
+    }
+
+    return texture;
+}
+
+TextureHandle TextureManager::loadLayeredTexture(
+    const std::vector<std::string>& filenames,
+    vk::ImageViewType viewType,
+    vk::SamplerAddressMode addressMode)
+{
+    std::string combinedFilenames;
+    for (auto& filename : filenames) {
+        combinedFilenames += filename;
+    }
+
+    auto it = mSlotsBySource.find({combinedFilenames, addressMode});
+    if (it != mSlotsBySource.end()) {
+        TextureHandle handle{it->second, mSlots[it->second].generation};
+        acquire(handle);
+        return handle;
+    }
+
+    // Volume slices skip CPU mips since only their base level is uploaded.
+    bool linearBlit =
+        viewType == vk::ImageViewType::e3D || supportsLinearBlit(mDevice, vk::Format::eR8G8B8A8Unorm);
+
+    std::vector<std::future<TextureData>> pendingLayers{};
+    for (auto& filename : filenames) {
+        pendingLayers.push_back(
+            mDevice.threadPool().submit([&device = mDevice, filename, linearBlit]() {
+                return decodeTexture(device, filename, linearBlit);
+            }));
+    }
+
+    // Wait for every decode before rethrowing so no job outlives the call.
+    std::vector<TextureData> layers{};
+    std::exception_ptr error{};
+    for (auto& pendingLayer : pendingLayers) {
+        try {
+            layers.push_back(pendingLayer.get());
+        } catch (...) {
+            error = std::current_exception();
+        }
+    }
+    if (error) {
+        std::rethrow_exception(error);
+    }
+
+    std::vector<TextureData> textures{};
+    textures.push_back(layeredTextureData(layers, viewType));
+    textures.back().addressMode = addressMode;
+
+    return insertTexture(
+        combinedFilenames, addressMode, std::move(uploadTextures(textures).front()));
+}
+
+TextureHandle TextureManager::loadCubeTexture(const std::array<std::string, 6>& filenames)
+{
+    return loadLayeredTexture(
+        {filenames.begin(), filenames.end()},
+        vk::ImageViewType::eCube,
+        vk::SamplerAddressMode::eClampToEdge);
 }
@@ -0,0 +1,53 @@
+#include "../Include/ThreadPool.h"
+
+ThreadPool::ThreadPool(size_t threadCount) : mStopping{false}
+{
+    for (size_t i = 0; i < threadCount; i++) {
+        mThreads.emplace_back([this]() { run(); });
+    }
+}
+
+ThreadPool::~ThreadPool()
+{
+    shutdown();
+}
+
+void ThreadPool::shutdown()
+{
+    {
+        std::lock_guard<std::mutex> lock{mMutex};
+        mStopping = true;
+    }
+    mCondition.notify_all();
+
+    for (auto& thread : mThreads) {
+        if (thread.joinable()) {
+            thread.join();
+        }
+    }
+}
+
+void ThreadPool::run()
+{
+    for (;;) {
+        std::function<void()> task;
+        {
+            std::unique_lock<std::mutex> lock{mMutex};
+            mCondition.wait(lock, [this]() { return mStopping || !mTasks.empty(); });
+
+            // Drain queued work before exiting so pending futures are always satisfied.
+            if (mTasks.empty()) {
+                return;
+            }
+            task = std::move(mTasks.front());
+            mTasks.pop();
+        }
+        task();
+    }
+}
+
+size_t defaultThreadCount()
+{
+    size_t hardwareThreads = std::thread::hardware_concurrency();
+    return hardwareThreads > 1 ? hardwareThreads - 1 : 1;
+}
@@ -0,0 +1,49 @@
+#include "../Include/MeshFile.h"
+#include "../Include/MeshOptimizer.h"
+#include "../Include/MeshSimplifier.h"
+#include <iostream>
+
+static void printStatistics(const char* label, const MeshData& mesh)
+{
+    const MeshLod& lod = mesh.lods.front();
+    VertexCacheStatistics statistics = analyzeVertexCache(
+        mesh.indices.data() + lod.firstIndex, lod.indexCount, mesh.vertices.size());
+    std::cout << label << ": " << mesh.vertices.size() << " vertices, ACMR " << statistics.acmr
+              << ", ATVR " << statistics.atvr << "\n";
+}
+
+// Converts a legacy "paskaformaatti 1.0" mesh, or rewrites a chunked one, into the current
+// chunked mesh format. Unless --no-optimize is given, meshes get simplified LODs and are optimized
+// for vertex cache, overdraw and vertex fetch.
+int main(int argc, char** argv)
+{
+    bool optimize = !(argc == 4 && std::string(argv[1]) == "--no-optimize");
+    if (argc != 3 && optimize) {
+        std::cout << "Usage: MeshConverter [--no-optimize] <input> <output>\n";
+        return 1;
+    }
+    const char* input = argv[argc - 2];
+    const char* output = argv[argc - 1];
+
+    try {
+        MeshData mesh = readMeshFile(input);
+        if (optimize) {
+            printStatistics("Before", mesh);
+            generateLods(mesh);
+            optimizeMesh(mesh);
+            for (auto& lod : mesh.lods) {
+                std::cout << "LOD " << lod.indexCount / 3 << " triangles, error " << lod.error
+                          << "\n";
+            }
+            printStatistics("After", mesh);
+        }
+        writeMeshFile(output, mesh);
+        std::cout << "Mesh converted " << output << " (" << mesh.vertices.size() << " vertices, "
+                  << mesh.indices.size() << " indices)\n";
+    } catch (const std::exception& e) {
+        std::cout << e.what() << "\n";
+        return 1;
+    }
+
+    return 0;
+}
@@ -0,0 +1,31 @@
+#include "../Include/PipelineDescription.h"
+#include <fstream>
+#include <iostream>
+#include <json.hpp>
+
+// Compiles a JSON pipeline description into the binary form read by loadPipelineDescription.
+int main(int argc, char** argv)
+{
+    if (argc != 3) {
+        std::cout << "Usage: PipelineCompiler <input.json> <output>\n";
+        return 1;
+    }
+
+    try {
+        std::ifstream file(argv[1]);
+        if (!file.is_open()) {
+            throw std::runtime_error(std::string("Failed to open ") + argv[1]);
+        }
+
+        nlohmann::json json{};
+        file >> json;
+
+        writePipelineDescription(argv[2], parsePipelineDescription(json));
+        std::cout << "Pipeline description compiled " << argv[2] << "\n";
+    } catch (const std::exception& e) {
+        std::cout << e.what() << "\n";
+        return 1;
+    }
+
+    return 0;
+}
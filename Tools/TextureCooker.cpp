@@ -0,0 +1,132 @@
+#define STB_IMAGE_IMPLEMENTATION
+
+#include "../Include/CookedTexture.h"
+#include "../Include/DdsFile.h"
+#include <algorithm>
+#include <iostream>
+#include <stb_image.h>
+
+static bool hasExtension(const std::string& filename, const std::string& extension)
+{
+    if (filename.size() < extension.size()) {
+        return false;
+    }
+    return std::equal(extension.rbegin(), extension.rend(), filename.rbegin(), [](char a, char b) {
+        return tolower(a) == tolower(b);
+    });
+}
+
+// DDS files are already block compressed with their mips, only the layout is rewritten.
+static void cookDds(
+    const std::string& filename, CookedTextureLayout& layout, std::vector<uint8_t>& data)
+{
+    DdsImage image = readDdsFile(filename);
+
+    if (image.cube && image.layerCount == 6) {
+        layout.viewType = vk::ImageViewType::eCube;
+    } else if (image.cube) {
+        layout.viewType = vk::ImageViewType::eCubeArray;
+    } else if (image.layerCount > 1) {
+        layout.viewType = vk::ImageViewType::e2DArray;
+    } else {
+        layout.viewType = vk::ImageViewType::e2D;
+    }
+    layout.format = image.format;
+    layout.extent = image.extent;
+    layout.layerCount = image.layerCount;
+    layout.mipLevels = image.mipLevels;
+
+    for (uint32_t layer = 0; layer < image.layerCount; layer++) {
+        for (uint32_t level = 0; level < image.mipLevels; level++) {
+            const DdsLevel& ddsLevel = image.levels[layer * image.mipLevels + level];
+            const char* levelData = image.data.data() + ddsLevel.offset;
+
+            vk::BufferImageCopy region{};
+            region.bufferOffset = data.size();
+            region.imageSubresource.aspectMask = vk::ImageAspectFlagBits::eColor;
+            region.imageSubresource.mipLevel = level;
+            region.imageSubresource.baseArrayLayer = layer;
+            region.imageSubresource.layerCount = 1;
+            region.imageExtent = ddsLevel.extent;
+            layout.regions.push_back(region);
+
+            data.insert(data.end(), levelData, levelData + ddsLevel.size);
+        }
+    }
+}
+
+// Decodes each image to RGBA8 and box filters the full mip chain, one layer per image.
+static void cookImages(
+    const std::vector<std::string>& filenames,
+    CookedTextureLayout& layout,
+    std::vector<uint8_t>& data)
+{
+    layout.viewType = filenames.size() == 6 ? vk::ImageViewType::eCube : vk::ImageViewType::e2D;
+    layout.format = vk::Format::eR8G8B8A8Unorm;
+    layout.layerCount = static_cast<uint32_t>(filenames.size());
+
+    for (uint32_t layer = 0; layer < filenames.size(); layer++) {
+        int width = 0;
+        int height = 0;
+        int channelCount = 0;
+
+        stbi_uc* pixels =
+            stbi_load(filenames[layer].data(), &width, &height, &channelCount, STBI_rgb_alpha);
+        if (!pixels) {
+            throw std::runtime_error("Failed to load texture image " + filenames[layer]);
+        }
+
+        vk::Extent3D extent(width, height, 1);
+        if (layer == 0) {
+            layout.extent = extent;
+            layout.mipLevels = mipLevelCount(extent);
+        } else if (extent != layout.extent) {
+            stbi_image_free(pixels);
+            throw std::runtime_error("Cube faces must all have the same size!");
+        }
+
+        std::vector<vk::BufferImageCopy> regions{};
+        auto chain = createMipChain(pixels, extent, layout.mipLevels, regions);
+        stbi_image_free(pixels);
+
+        for (auto& region : regions) {
+            region.bufferOffset += data.size();
+            region.imageSubresource.baseArrayLayer = layer;
+            layout.regions.push_back(region);
+        }
+        data.insert(data.end(), chain.begin(), chain.end());
+    }
+}
+
+// Converts source images into the GPU ready layout read by readCookedTexture. One input cooks a
+// 2D texture, six inputs cook a cube map with faces in +X, -X, +Y, -Y, +Z, -Z order.
+int main(int argc, char** argv)
+{
+    if (argc != 3 && argc != 8) {
+        std::cout << "Usage: TextureCooker <input> <output.ctex>\n";
+        std::cout << "       TextureCooker <+x> <-x> <+y> <-y> <+z> <-z> <output.ctex>\n";
+        return 1;
+    }
+
+    try {
+        std::vector<std::string> inputs(argv + 1, argv + argc - 1);
+        std::string output = argv[argc - 1];
+
+        CookedTextureLayout layout{};
+        std::vector<uint8_t> data{};
+
+        if (inputs.size() == 1 && hasExtension(inputs.front(), ".dds")) {
+            cookDds(inputs.front(), layout, data);
+        } else {
+            cookImages(inputs, layout, data);
+        }
+
+        writeCookedTexture(output, layout, data);
+        std::cout << "Texture cooked " << output << "\n";
+    } catch (const std::exception& e) {
+        std::cout << e.what() << "\n";
+        return 1;
+    }
+
+    return 0;
+}